@@ -19,6 +19,7 @@
  */
 #include "ns3/non-communicating-net-device.h"
 #include <ns3/okumura-hata-propagation-loss-model.h>
+#include <ns3/propagation-loss-model.h>
 #include <ns3/core-module.h>
 #include <ns3/packet.h>
 #include <ns3/lora-module.h>
@@ -26,6 +27,8 @@
 #include <ns3/mobility-module.h>
 #include <ns3/energy-module.h>
 #include <ns3/spectrum-value.h>
+#include <ns3/spectrum-model.h>
+#include <ns3/system-wall-clock-ms.h>
 #include <ns3/spectrum-analyzer.h>
 #include <ns3/rectangle.h>
 //#include <ns3/log.h>
@@ -71,6 +74,7 @@ bool optimized = false;
 bool monitorEnergy = false;
 bool interference = false;
 bool randomSend = false;
+bool compact = false;
 double length = 1000;			//!< Square city with length as distance
 double iterationCount = 5;			//!< Square city with length as distance
 int pktsize = 51;              //!< size of packets, in bytes
@@ -80,7 +84,10 @@ double interval = 120;        // interval between packets, minutes
 bool verbose = false;          // enable logging (different from trace)
 bool nakagami = true;         // enable nakagami path loss
 bool dynamic = false;          // enable random moving of pan node
+std::string channelType = "ns3::MultiModelSpectrumChannel"; // type of the spectrum channel
+std::string phyMode = "spectrum"; // spectrum, abstract or validate
 uint32_t nSensors = 500; // numbenir of sent packets
+uint32_t nBackground = 0; // devices only simulated as interference at the gateways
 uint32_t nGateways = 1; // numbenir of sent packets
 uint32_t reportingInterval = 0; // numbenir of sent packets
 Ptr<OutputStreamWrapper> m_stream = 0;
@@ -114,6 +121,20 @@ GetClosestGateway (Ptr<MobilityModel> location)
 }
 
 
+/// Number of spectrum models created so far, every model gets the next uid
+	uint32_t
+CountSpectrumModels ()
+{
+	// the probe models themselves are not counted
+	static uint32_t probes = 0;
+	probes++;
+	BandInfo band;
+	band.fl = 868e6;
+	band.fc = 868e6+12500;
+	band.fh = 868e6+25000;
+	return Create<SpectrumModel> (Bands (1, band))->GetUid ()-probes;
+}
+
 /// Save that teh message has been transmitted
 	void
 Transmitted (const Ptr<const Packet> packet)
@@ -276,7 +297,7 @@ mainBody ()
 	//Channel
 	std::cout << "Create channel" << std::endl;
 	SpectrumChannelHelper channelHelper;
-	channelHelper.SetChannel ("ns3::MultiModelSpectrumChannel");
+	channelHelper.SetChannel (channelType);
 	if (nakagami)
 	{
 		channelHelper.AddPropagationLoss ("ns3::OkumuraHataPropagationLossModel","Frequency",DoubleValue(868e6));
@@ -290,6 +311,22 @@ mainBody ()
 	Ptr<SpectrumChannel> channel = channelHelper.Create ();
 	LoRaHelper lorahelper;
 	lorahelper.SetChannel (channel);
+	if (phyMode != "spectrum")
+	{
+		lorahelper.SetPhyMode (phyMode == "abstract" ? LoRaHelper::ABSTRACT_PHY : LoRaHelper::VALIDATION_PHY);
+		// the same loss chain as the spectrum channel, so validation only compares the PHYs
+		Ptr<OkumuraHataPropagationLossModel> hata = CreateObject<OkumuraHataPropagationLossModel> ();
+		hata->SetAttribute ("Frequency",DoubleValue(868e6));
+		if (nakagami)
+		{
+			Ptr<NakagamiPropagationLossModel> fading = CreateObject<NakagamiPropagationLossModel> ();
+			fading->SetAttribute ("m0",DoubleValue(1));
+			fading->SetAttribute ("m1",DoubleValue(1));
+			fading->SetAttribute ("m2",DoubleValue(1));
+			hata->SetNext (fading);
+		}
+		lorahelper.GetAbstractChannel ()->SetPropagationLossModel (hata);
+	}
 
 
 	// Configure gateways
@@ -316,7 +353,11 @@ mainBody ()
 		}
 	}
 	else
+	{
+		lorahelper.SetCompactDevices (compact);
 		loraNetDevices = lorahelper.Install (loraDeviceNodes);
+		lorahelper.PrintMemoryReport (std::cout);
+	}
 
 
 	// Check if reliable
@@ -417,11 +458,40 @@ mainBody ()
 		lorahelper.AddInterference(mobilityInterference);
 	}
 
+	// Configure the devices that are not simulated in detail
+	if (nBackground > 0)
+	{
+		std::cout << "Background population of " << nBackground << " devices" << std::endl;
+		std::vector<Vector> positions;
+		for (uint32_t n = 0; n < nBackground; n++)
+		{
+			double x,y;
+			do{
+				x = randT->GetValue(0,2*lengthMax);
+				y = randT->GetValue(0,2*lengthMax);
+			}
+			while ((x-length)*(x-length)+(y-length)*(y-length) > lengthMax*lengthMax);
+			positions.push_back (Vector (x,y,1.0));
+		}
+		Ptr<OkumuraHataPropagationLossModel> hata = CreateObject<OkumuraHataPropagationLossModel> ();
+		hata->SetAttribute ("Frequency",DoubleValue(868e6));
+		lorahelper.AddAggregateInterference (gateways, positions, interval, hata, Seconds (0));
+	}
 
 	// Start the simulation
 	std::cout << "start the fun" << std::endl;
+	uint32_t spectrumModels = CountSpectrumModels ();
+	SystemWallClockMs clock;
+	clock.Start ();
 	Simulator::Stop (Seconds (duration));
 	Simulator::Run ();
+	int64_t elapsed = clock.End ();
+	std::cout << "simulated " << duration << " s in " << elapsed << " ms wall clock, "
+		<< CountSpectrumModels ()-spectrumModels << " spectrum models created while running" << std::endl;
+	if (lorahelper.GetValidator () != 0)
+	{
+		lorahelper.GetValidator ()->Report (std::cout);
+	}
 
 	return 0;
 }
@@ -437,6 +507,7 @@ main (int argc, char** argv)
 	cmd.AddValue ("learning", "CCMAB for learning ideal spreading factor set", learning);
 	cmd.AddValue ("gateways", "The amount of gateways (up to 7) (1,4,7 for optimal performance)", nGateways);
 	cmd.AddValue ("sensors", "The amount of sensors", nSensors);
+	cmd.AddValue ("background", "The amount of sensors only simulated as interference at the gateways", nBackground);
 	cmd.AddValue ("interference", "Use measured interference", interference);
 	cmd.AddValue ("optimized", "Use the best static spreading factor set [haven't used this in a very long time. Use at your own risk, I hard coded a few things]", optimized);
 	cmd.AddValue ("length", "Radius of a cell", length);
@@ -445,7 +516,10 @@ main (int argc, char** argv)
 	cmd.AddValue ("monitorEnergy", "Monitors the energy of the nodes", monitorEnergy);
 	cmd.AddValue ("iterationCount", "The amount of repeated simulations", iterationCount);
 	cmd.AddValue ("randomSend", "Add randomness to interval", randomSend);
+	cmd.AddValue ("compact", "Share the antenna, error model and random generator of the end devices", compact);
 	cmd.AddValue ("reportingInterval","The interval for reporting statistics",reportingInterval);
+	cmd.AddValue ("phy", "The PHY of the devices: spectrum, abstract (analytic) or validate (both, compared at the gateways)", phyMode);
+	cmd.AddValue ("channel", "The spectrum channel (ns3::LoRaSpectrumChannel only delivers to listening devices, ns3::LoRaSubBandSpectrumChannel also only to the sub-band they listen on)", channelType);
 
 	cmd.Parse (argc,argv);
 	AsciiTraceHelper ascii;
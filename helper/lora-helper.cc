@@ -27,12 +27,14 @@
 #include <ns3/propagation-loss-model.h>
 #include <ns3/propagation-delay-model.h>
 #include <ns3/isotropic-antenna-model.h>
-#include <ns3/drop-tail-queue.h>
 #include <ns3/log.h>
 #include <ns3/double.h>
 #include "ns3/names.h"
 #include <ns3/random-variable-stream.h>
 #include <ns3/pointer.h>
+#include <ns3/boolean.h>
+#include <fstream>
+#include <unistd.h>
 
 namespace ns3 {
 
@@ -77,13 +79,143 @@ LoRaHelper::LoRaHelper (void)
   Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
   m_channel->SetPropagationDelayModel (delayModel);
 	m_spectrumModel = 0;
+	m_phyMode = SPECTRUM_PHY;
+	m_compact = false;
+	m_installedDevices = 0;
+	m_installedMemory = 0;
+}
+
+LoRaHelper::LoRaHelper (bool useLoRaSpectrumChannel)
+{
+  if (useLoRaSpectrumChannel)
+    {
+      m_channel = CreateObject<LoRaSpectrumChannel> ();
+    }
+  else
+    {
+      m_channel = CreateObject<MultiModelSpectrumChannel> ();
+    }
+
+  Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
+  m_channel->AddPropagationLossModel (lossModel);
+
+  Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  m_channel->SetPropagationDelayModel (delayModel);
+	m_spectrumModel = 0;
+	m_phyMode = SPECTRUM_PHY;
+	m_compact = false;
+	m_installedDevices = 0;
+	m_installedMemory = 0;
 }
 
 LoRaHelper::~LoRaHelper (void)
 {
   m_channel->Dispose ();
   m_channel = 0;
+  if (m_abstractChannel != 0)
+    {
+      m_abstractChannel->Dispose ();
+      m_abstractChannel = 0;
+    }
+  m_validator = 0;
 	m_spectrumModel = 0;
+	m_sharedAntenna = 0;
+	m_sharedErrorModel = 0;
+	m_sharedRandom = 0;
+}
+
+void
+LoRaHelper::SetCompactDevices (bool compact)
+{
+  m_compact = compact;
+  if (compact && m_sharedAntenna == 0)
+    {
+      m_sharedAntenna = CreateObject<IsotropicAntennaModel> ();
+      m_sharedErrorModel = CreateObject<LoRaErrorModel> ();
+      m_sharedRandom = CreateObject<UniformRandomVariable> ();
+    }
+}
+
+uint64_t
+LoRaHelper::GetResidentMemory (void)
+{
+  // the second field of statm is the resident set in pages
+  std::ifstream statm ("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  if (!(statm >> size >> resident))
+    {
+      return 0;
+    }
+  return resident*sysconf (_SC_PAGESIZE);
+}
+
+void
+LoRaHelper::PrintMemoryReport (std::ostream &os) const
+{
+  os << "end devices installed: " << m_installedDevices << (m_compact ? " (compact)" : "") << std::endl;
+  if (m_installedDevices > 0 && m_installedMemory > 0)
+    {
+      os << "resident memory per end device: " << m_installedMemory/m_installedDevices << " B" << std::endl;
+    }
+  // the objects themselves, without what they allocate on the heap
+  os << "LoRaNetDevice: " << sizeof (LoRaNetDevice) << " B" << std::endl;
+  os << (m_phyMode == ABSTRACT_PHY ? "LoRaAbstractPhy: " : "LoRaPhy: ")
+     << (m_phyMode == ABSTRACT_PHY ? sizeof (LoRaAbstractPhy) : sizeof (LoRaPhy)) << " B" << std::endl;
+  os << "received power while receiving: " << 2*sizeof (LoRaPowerVector) << " B" << std::endl;
+  os << "uplink queue (in LoRaNetDevice): " << sizeof (LoRaUplinkQueue) << " B" << std::endl;
+  if (!m_compact)
+    {
+      os << "antenna, error model and 2 random generators: "
+         << sizeof (IsotropicAntennaModel) + sizeof (LoRaErrorModel) + 2*sizeof (UniformRandomVariable) << " B" << std::endl;
+    }
+}
+
+void
+LoRaHelper::EnableSubBandChannels (const std::vector<std::pair<double,double> > &bands)
+{
+  Ptr<LoRaSubBandSpectrumChannel> channel = CreateObject<LoRaSubBandSpectrumChannel> ();
+  for (std::vector<std::pair<double,double> >::const_iterator it = bands.begin (); it != bands.end (); it++)
+    {
+      channel->AddSubBand (it->first, it->second);
+    }
+
+  Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
+  channel->AddPropagationLossModel (lossModel);
+
+  Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  channel->SetPropagationDelayModel (delayModel);
+
+  m_channel->Dispose ();
+  m_channel = channel;
+}
+
+void
+LoRaHelper::SetPhyMode (PhyMode mode)
+{
+  m_phyMode = mode;
+  if (mode != SPECTRUM_PHY && m_abstractChannel == 0)
+    {
+      m_abstractChannel = CreateObject<LoRaAbstractChannel> ();
+      m_abstractChannel->SetPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+      m_abstractChannel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+    }
+  if (mode == VALIDATION_PHY && m_validator == 0)
+    {
+      m_validator = CreateObject<LoRaPhyValidator> ();
+    }
+}
+
+Ptr<LoRaAbstractChannel>
+LoRaHelper::GetAbstractChannel (void)
+{
+  return m_abstractChannel;
+}
+
+Ptr<LoRaPhyValidator>
+LoRaHelper::GetValidator (void)
+{
+  return m_validator;
 }
 
 void
@@ -164,6 +296,7 @@ NetDeviceContainer
 LoRaHelper::Install (NodeContainer c)
 {
   NetDeviceContainer devices;
+  uint64_t residentBefore = GetResidentMemory ();
 	//remove first MAC address, it is reserved for base stations.
 	Mac32Address::Allocate();
   for (NodeContainer::Iterator i = c.Begin (); i != c.End (); i++)
@@ -171,23 +304,51 @@ LoRaHelper::Install (NodeContainer c)
 		Ptr<Node> nodeI = *i;
 		Ptr<LoRaNetDevice> anandi = CreateObject<LoRaNetDevice> ();
 		devices.Add(anandi);
-		Ptr<LoRaPhy> sfp = CreateObject<LoRaPhy> ();
-		if (m_spectrumModel == 0)
-			m_spectrumModel = sfp->GetRxSpectrumModel();
+		Ptr<LoRaPhy> sfp;
+		if (m_phyMode == ABSTRACT_PHY)
+		{
+			Ptr<LoRaAbstractPhy> abstractPhy = CreateObject<LoRaAbstractPhy> ();
+			sfp = abstractPhy;
+			anandi->SetPhy (sfp);
+			anandi->SetChannel (m_abstractChannel);
+			sfp->SetDevice(anandi);
+			sfp->SetMobility (nodeI->GetObject<MobilityModel> ());
+			abstractPhy->SetAbstractChannel (m_abstractChannel);
+			anandi->SetGenericPhyTxStartCallback (MakeCallback(&LoRaAbstractPhy::StartTx,abstractPhy));
+		}
 		else
-			sfp->SetRxSpectrumModel (m_spectrumModel);
-		anandi->SetPhy (sfp);
-		anandi->SetChannel (m_channel);
+		{
+			sfp = CreateObject<LoRaPhy> ();
+			if (m_spectrumModel == 0)
+				m_spectrumModel = sfp->GetRxSpectrumModel();
+			else
+				sfp->SetRxSpectrumModel (m_spectrumModel);
+			anandi->SetPhy (sfp);
+			anandi->SetChannel (m_channel);
+			sfp->SetDevice(anandi);
+			sfp->SetMobility (nodeI->GetObject<MobilityModel> ());
+			sfp->SetChannel (m_channel);
+			sfp->SetRxAntenna (m_compact ? m_sharedAntenna : CreateObject<IsotropicAntennaModel> ());
+			anandi->SetGenericPhyTxStartCallback (MakeCallback(&LoRaPhy::StartTx,sfp));
+			if (m_phyMode == VALIDATION_PHY)
+			{
+				// the shadow only transmits, receptions are compared at the gateways
+				Ptr<LoRaAbstractPhy> shadow = CreateObject<LoRaAbstractPhy> ();
+				shadow->SetDevice(anandi);
+				shadow->SetMobility (nodeI->GetObject<MobilityModel> ());
+				shadow->SetAbstractChannel (m_abstractChannel);
+				anandi->SetGenericPhyTxStartCallback (MakeBoundCallback(&LoRaPhyValidator::StartTx,sfp,shadow));
+			}
+		}
+		if (m_compact)
+		{
+			sfp->SetErrorModel (m_sharedErrorModel);
+			sfp->SetRandomVariable (m_sharedRandom);
+			sfp->SetAttribute ("ReleaseIdleReceiver", BooleanValue (true));
+			anandi->SetRandomVariable (m_sharedRandom);
+		}
 		anandi->SetAddress(Mac32Address::Allocate());
-		Ptr<Queue<QueueItem>> queue = Create<DropTailQueue<QueueItem>>();
-		queue->SetMaxSize((QueueSize("100p")));
-		anandi->SetQueue(queue);
-		sfp->SetDevice(anandi);
-		sfp->SetMobility (nodeI->GetObject<MobilityModel> ());
-		sfp->SetChannel (m_channel);
-		sfp->SetRxAntenna (CreateObject<IsotropicAntennaModel> ());
 		nodeI->AddDevice(anandi);
-		anandi->SetGenericPhyTxStartCallback (MakeCallback(&LoRaPhy::StartTx,sfp));
 		sfp->SetTransmissionEndCallback( MakeCallback(&LoRaNetDevice::NotifyTransmissionEnd,anandi));
 		sfp->SetReceptionEndCallback ( MakeCallback(&LoRaNetDevice::NotifyReceptionEndOk,anandi));
 		sfp->SetReceptionErrorCallback ( MakeCallback(&LoRaNetDevice::NotifyReceptionEndError,anandi));
@@ -198,6 +359,9 @@ LoRaHelper::Install (NodeContainer c)
   			anandi->TraceConnectWithoutContext(std::get<0>(*it),std::get<1>(*it));
     	}
     }
+  uint64_t residentAfter = GetResidentMemory ();
+  m_installedDevices += devices.GetN ();
+  m_installedMemory += (int64_t) residentAfter-(int64_t) residentBefore;
   return devices;
 }
 
@@ -218,9 +382,6 @@ LoRaHelper::InstallRs (NodeContainer c)
 		anandi->SetPhy (sfp);
 		anandi->SetChannel (m_channel);
 		anandi->SetAddress(Mac32Address::Allocate());
-		Ptr<Queue<QueueItem>> queue = Create<DropTailQueue<QueueItem>>();
-		queue->SetMaxSize((QueueSize("100p")));
-		anandi->SetQueue(queue);
 		sfp->SetDevice(anandi);
 		sfp->SetMobility (nodeI->GetObject<MobilityModel> ());
 		sfp->SetChannel (m_channel);
@@ -248,27 +409,48 @@ LoRaHelper::InstallGateways (NodeContainer c)
   {
   	Ptr<Node> nodeJ = *i;
   	Ptr<LoRaGwNetDevice> anand = CreateObject<LoRaGwNetDevice> ();
-  	Ptr<LoRaGwPhy> sfp = CreateObject<LoRaGwPhy> ();
-		if (m_spectrumModel == 0)
-			m_spectrumModel = sfp->GetRxSpectrumModel();
-		else
-			sfp->SetRxSpectrumModel (m_spectrumModel);
-  	anand->SetPhy (sfp);
+  	Ptr<LoRaGwPhy> sfp;
   	devices.Add(anand);
-  	anand->SetChannel (m_channel);
-  	sfp->SetDevice(anand);
-  	sfp->SetMobility (nodeJ->GetObject<MobilityModel> ());
-  	sfp->SetChannel (m_channel);
-  	sfp->SetRxAntenna (CreateObject<IsotropicAntennaModel> ());
-		Ptr<Queue<QueueItem>> queue = Create<DropTailQueue<QueueItem>>();
-		queue->SetMaxSize((QueueSize("100p")));
-		anand->SetQueue(queue);
+		if (m_phyMode == ABSTRACT_PHY)
+		{
+			Ptr<LoRaAbstractGwPhy> abstractPhy = CreateObject<LoRaAbstractGwPhy> ();
+			sfp = abstractPhy;
+			anand->SetPhy (sfp);
+			anand->SetChannel (m_abstractChannel);
+			sfp->SetDevice(anand);
+			sfp->SetMobility (nodeJ->GetObject<MobilityModel> ());
+			abstractPhy->SetAbstractChannel (m_abstractChannel);
+			anand->SetGenericPhyTxStartCallback (MakeCallback(&LoRaAbstractGwPhy::StartTx,abstractPhy));
+		}
+		else
+		{
+			sfp = CreateObject<LoRaGwPhy> ();
+			if (m_spectrumModel == 0)
+				m_spectrumModel = sfp->GetRxSpectrumModel();
+			else
+				sfp->SetRxSpectrumModel (m_spectrumModel);
+			anand->SetPhy (sfp);
+			anand->SetChannel (m_channel);
+			sfp->SetDevice(anand);
+			sfp->SetMobility (nodeJ->GetObject<MobilityModel> ());
+			sfp->SetChannel (m_channel);
+			sfp->SetRxAntenna (CreateObject<IsotropicAntennaModel> ());
+			anand->SetGenericPhyTxStartCallback (MakeCallback(&LoRaGwPhy::StartTx,sfp));
+		}
   	nodeJ->AddDevice(anand);
-  	anand->SetGenericPhyTxStartCallback (MakeCallback(&LoRaGwPhy::StartTx,sfp));
   	sfp->SetTransmissionEndCallback( MakeCallback(&LoRaGwNetDevice::NotifyTransmissionEnd,anand));
   	sfp->SetReceptionEndCallback ( MakeCallback(&LoRaGwNetDevice::NotifyReceptionEndOk,anand));
   	sfp->SetReceptionStartCallback ( MakeCallback(&LoRaGwNetDevice::NotifyReceptionStart,anand));
   	sfp->SetReceptionErrorCallback ( MakeCallback(&LoRaGwNetDevice::NotifyReceptionEndError,anand));
+		if (m_phyMode == VALIDATION_PHY)
+		{
+			Ptr<LoRaAbstractGwPhy> shadow = CreateObject<LoRaAbstractGwPhy> ();
+			shadow->SetDevice(anand);
+			shadow->SetMobility (nodeJ->GetObject<MobilityModel> ());
+			shadow->SetAbstractChannel (m_abstractChannel);
+			anand->SetGenericPhyTxStartCallback (MakeBoundCallback(&LoRaPhyValidator::StartGwTx,sfp,shadow));
+			m_validator->Watch (sfp, shadow, MakeCallback(&LoRaGwNetDevice::NotifyReceptionEndOk,anand));
+		}
     for (std::list<callbacktuple>::iterator it = m_gatewayCallbacks.begin(); it!= m_gatewayCallbacks.end();it++)
     {
   		anand->TraceConnectWithoutContext(std::get<0>(*it),std::get<1>(*it));
@@ -298,9 +480,6 @@ LoRaHelper::InstallRsGateways (NodeContainer c)
   	sfp->SetMobility (nodeJ->GetObject<MobilityModel> ());
   	sfp->SetChannel (m_channel);
   	sfp->SetRxAntenna (CreateObject<IsotropicAntennaModel> ());
-		Ptr<Queue<QueueItem>> queue = Create<DropTailQueue<QueueItem>>();
-		queue->SetMaxSize((QueueSize("100p")));
-		anand->SetQueue(queue);
   	nodeJ->AddDevice(anand);
   	anand->SetGenericPhyTxStartCallback (MakeCallback(&LoRaGwPhy::StartTx,sfp));
   	sfp->SetTransmissionEndCallback( MakeCallback(&LoRaRsGwNetDevice::NotifyTransmissionEnd,anand));
@@ -709,5 +888,33 @@ LoRaHelper::AddInterference (MobilityHelper helper)
 	return container;
 }
 
+Ptr<LoRaAggregateInterference>
+LoRaHelper::AddAggregateInterference (NetDeviceContainer gateways, const std::vector<Vector> &positions, double interval, Ptr<PropagationLossModel> loss, Time start)
+{
+	Ptr<LoRaAggregateInterference> aggregate = CreateObject<LoRaAggregateInterference> ();
+	aggregate->SetAttribute ("PropagationLossModel", PointerValue (loss));
+	for (NetDeviceContainer::Iterator it = gateways.Begin (); it != gateways.End (); it++)
+	{
+		aggregate->AddGateway (DynamicCast<LoRaGwNetDevice> (*it)->GetPhy ());
+	}
+	// the 3 default channels and the SF7..SF12 sensitivities at 125 kHz (dBm)
+	uint32_t channels[] = {8681000,8683000,8685000};
+	double sensitivity[] = {-123,-126,-129,-132,-134.5,-137};
+	Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+	for (std::vector<Vector>::const_iterator it = positions.begin (); it != positions.end (); it++)
+	{
+		double rxPower = aggregate->GetRxPower (*it);
+		uint8_t sf = 7;
+		while (sf < 12 && rxPower < sensitivity[sf-7])
+		{
+			sf++;
+		}
+		aggregate->AddDevice (*it, channels[random->GetInteger (0,2)], sf, 125000, interval);
+	}
+	NS_LOG_INFO ("aggregate interference of " << aggregate->GetAudible () << " out of " << aggregate->GetPopulation () << " devices");
+	aggregate->Start (start);
+	return aggregate;
+}
+
 } // namespace ns3
 
@@ -25,14 +25,19 @@
 #include <ns3/mobility-helper.h>
 #include <ns3/application-container.h>
 #include <ns3/lora-phy.h>
+#include <ns3/lora-abstract-channel.h>
+#include <ns3/lora-phy-validator.h>
+#include <ns3/lora-aggregate-interference.h>
 #include <ns3/trace-helper.h>
 #include <ns3/callback.h>
+#include <vector>
 
 namespace ns3 {
 
 class SpectrumChannel;
 class MobilityModel;
 class RandomVariableStream;
+class AntennaModel;
 /**
  * \ingroup lora
  *
@@ -52,6 +57,16 @@ public AsciiTraceHelperForDevice
 {
 public:
 
+	/**
+	 * \brief The PHY that Install and InstallGateways create
+	 */
+	enum PhyMode
+	{
+		SPECTRUM_PHY, //!< LoRaPhy and LoRaGwPhy on the spectrum channel
+		ABSTRACT_PHY, //!< LoRaAbstractPhy and LoRaAbstractGwPhy on a LoRaAbstractChannel
+		VALIDATION_PHY //!< the spectrum PHY with an analytic shadow, compared by a LoRaPhyValidator
+	};
+
 	/**
 	 * \brief Generate constant traffice from dev
 	 * \internal
@@ -79,15 +94,67 @@ public:
 
   /**
    * \brief Create a LoRa helper in an empty state with either a
-   * SingleModelSpectrumChannel or a MultiModelSpectrumChannel.
-   * \param useMultiModelSpectrumChannel use a MultiModelSpectrumChannel if true, a SingleModelSpectrumChannel otherwise
+   * LoRaSpectrumChannel or a MultiModelSpectrumChannel.
+   * \param useLoRaSpectrumChannel use a LoRaSpectrumChannel if true, a MultiModelSpectrumChannel otherwise
    *
    * A LogDistancePropagationLossModel and a 
    * ConstantSpeedPropagationDelayModel are added to the channel.
+   * On a LoRaSpectrumChannel, end devices only receive signals while their receiver is on.
    */
+	LoRaHelper (bool useLoRaSpectrumChannel);
 
 	virtual ~LoRaHelper (void);
 
+  /**
+   * \brief Replace the channel by a LoRaSubBandSpectrumChannel with a
+   * LogDistancePropagationLossModel and a ConstantSpeedPropagationDelayModel.
+   * Transmissions are then only propagated to the devices listening in the sub-bands
+   * they overlap with, while gateways get all of them. Call this before installing devices.
+   * \param bands low and high frequency in Hz of every sub-band, the EU868 sub-bands if empty
+   */
+  void EnableSubBandChannels (const std::vector<std::pair<double,double> > &bands);
+
+  /**
+   * \brief Select the PHY of the devices installed from now on. The analytic modes create
+   * a LoRaAbstractChannel with a LogDistancePropagationLossModel and a
+   * ConstantSpeedPropagationDelayModel. The RS devices always use the spectrum PHY.
+   * \param mode the PHY mode
+   */
+  void SetPhyMode (PhyMode mode);
+
+  /**
+   * \brief Install compact end devices from now on. They share one antenna, error model and
+   * random generator, and only keep the received power while signals arrive at them.
+   * Gateways and RS devices are not affected.
+   * \param compact true for compact end devices
+   */
+  void SetCompactDevices (bool compact);
+
+  /**
+   * \brief Print the memory of the end devices installed so far: the growth of the resident
+   * set during Install per device and the size of the objects of one device.
+   * \param os the output stream
+   */
+  void PrintMemoryReport (std::ostream &os) const;
+
+  /**
+   * \brief Get the resident set size of the simulation
+   * \returns the resident memory (bytes), 0 if the system does not report it
+   */
+  static uint64_t GetResidentMemory (void);
+
+  /**
+   * \brief Get the channel of the analytic PHY
+   * \returns the channel, 0 in SPECTRUM_PHY mode
+   */
+  Ptr<LoRaAbstractChannel> GetAbstractChannel (void);
+
+  /**
+   * \brief Get the comparison of both PHYs, call Report on it after the simulation
+   * \returns the validator, 0 unless in VALIDATION_PHY mode
+   */
+  Ptr<LoRaPhyValidator> GetValidator (void);
+
 	/**
    * \brief Get the channel associated to this helper
    * \returns the channel
@@ -201,6 +268,21 @@ public:
 		*/
 	NodeContainer AddInterference (MobilityHelper helper);
 
+	/**
+		* AddAggregateInterference represents the devices that are not simulated in detail
+		* by their uplink interference at the given gateways. Every device picks one of the
+		* 3 default channels at random and the lowest SF (125 kHz) whose sensitivity it meets
+		* at its best gateway.
+		*
+		* \param gateways the gateways under study
+		* \param positions the positions of the devices
+		* \param interval mean time between the packets of a device (s)
+		* \param loss the propagation loss model between the devices and the gateways
+		* \param start start of the traffic
+		* \return the interference process
+		*/
+	Ptr<LoRaAggregateInterference> AddAggregateInterference (NetDeviceContainer gateways, const std::vector<Vector> &positions, double interval, Ptr<PropagationLossModel> loss, Time start);
+
 private:
 	// Disable implicit constructors
   /**
@@ -242,11 +324,20 @@ private:
 			bool explicitFilename);
 
   Ptr<SpectrumChannel> m_channel; //!< channel to be used for the devices
+  PhyMode m_phyMode; //!< PHY of the installed devices
+  Ptr<LoRaAbstractChannel> m_abstractChannel; //!< channel of the analytic PHY
+  Ptr<LoRaPhyValidator> m_validator; //!< comparison of both PHYs
 	typedef std::tuple<std::string,CallbackBase> callbacktuple;
 	std::list<callbacktuple > m_gatewayCallbacks;
   std::list<callbacktuple > m_callbacks;
 	std::list<ObjectFactory > m_netApp;  //!< These are the applications installed on the network server
 	Ptr<const SpectrumModel> m_spectrumModel;
+  bool m_compact; //!< install compact end devices
+  Ptr<AntennaModel> m_sharedAntenna; //!< antenna of all compact end devices
+  Ptr<LoRaErrorModel> m_sharedErrorModel; //!< error model of all compact end devices
+  Ptr<UniformRandomVariable> m_sharedRandom; //!< random generator of all compact end devices
+  uint32_t m_installedDevices; //!< end devices installed by Install
+  int64_t m_installedMemory; //!< growth of the resident set during Install (bytes)
 
 };
 
@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-phy-validator.h"
+#include <ns3/lora-phy.h>
+#include <ns3/lora-gw-phy.h>
+#include <ns3/lora-abstract-phy.h>
+#include <ns3/lora-abstract-gw-phy.h>
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaPhyValidator");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaPhyValidator);
+
+TypeId
+LoRaPhyValidator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaPhyValidator")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaPhyValidator> ()
+  ;
+  return tid;
+}
+
+LoRaPhyValidator::LoRaPhyValidator ()
+{
+  NS_LOG_FUNCTION (this);
+  m_gateways = 0;
+}
+
+LoRaPhyValidator::~LoRaPhyValidator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+LoRaPhyValidator::StartTx (Ptr<LoRaPhy> phy, Ptr<LoRaAbstractPhy> shadow, Ptr<Packet> packet)
+{
+  // the device only configures the spectrum phy
+  shadow->SetChannelIndex (phy->GetChannelIndex ());
+  shadow->SetPower (phy->GetPower ());
+  shadow->SetBandwidth (phy->GetBandwidth ());
+  shadow->SetSpreadingFactor (phy->GetSpreadingFactor ());
+  shadow->ChangeState (LoRaTX);
+  shadow->StartTx (packet->Copy ());
+  return phy->StartTx (packet);
+}
+
+bool
+LoRaPhyValidator::StartGwTx (Ptr<LoRaGwPhy> phy, Ptr<LoRaAbstractGwPhy> shadow, Ptr<Packet> packet)
+{
+  shadow->SetChannelIndex (phy->GetChannelIndex ());
+  shadow->SetPower (phy->GetPower ());
+  shadow->SetBandwidth (phy->GetBandwidth ());
+  shadow->SetSpreadingFactor (phy->GetSpreadingFactor ());
+  shadow->StartTx (packet->Copy ());
+  return phy->StartTx (packet);
+}
+
+void
+LoRaPhyValidator::Watch (Ptr<LoRaGwPhy> phy, Ptr<LoRaAbstractGwPhy> shadow, GwReceptionCallback device)
+{
+  NS_LOG_FUNCTION (this << phy << shadow);
+  uint32_t gateway = m_gateways++;
+  phy->SetReceptionEndCallback (MakeBoundCallback (&LoRaPhyValidator::SpectrumReceived, Ptr<LoRaPhyValidator> (this), gateway, device));
+  shadow->SetReceptionEndCallback (MakeBoundCallback (&LoRaPhyValidator::AbstractReceived, Ptr<LoRaPhyValidator> (this), gateway));
+}
+
+void
+LoRaPhyValidator::SpectrumReceived (Ptr<LoRaPhyValidator> validator, uint32_t gateway, GwReceptionCallback device,
+                                    Ptr<Packet> packet, uint32_t bandwidth, uint8_t spreading, uint32_t frequency, double rssi)
+{
+  validator->m_spectrum.insert (std::make_pair (gateway, packet->GetUid ()));
+  device (packet, bandwidth, spreading, frequency, rssi);
+}
+
+void
+LoRaPhyValidator::AbstractReceived (Ptr<LoRaPhyValidator> validator, uint32_t gateway,
+                                    Ptr<Packet> packet, uint32_t bandwidth, uint8_t spreading, uint32_t frequency, double rssi)
+{
+  validator->m_abstract.insert (std::make_pair (gateway, packet->GetUid ()));
+}
+
+uint32_t
+LoRaPhyValidator::GetReceptions (bool abstract) const
+{
+  return abstract ? m_abstract.size () : m_spectrum.size ();
+}
+
+double
+LoRaPhyValidator::GetDivergence (void) const
+{
+  uint32_t both = 0;
+  for (std::set<std::pair<uint32_t, uint64_t> >::const_iterator it = m_spectrum.begin (); it != m_spectrum.end (); it++)
+    {
+      both += m_abstract.count (*it);
+    }
+  uint32_t all = m_spectrum.size ()+m_abstract.size ()-both;
+  return all == 0 ? 0.0 : (double)(all-both)/all;
+}
+
+void
+LoRaPhyValidator::Report (std::ostream &os) const
+{
+  uint32_t both = 0;
+  for (std::set<std::pair<uint32_t, uint64_t> >::const_iterator it = m_spectrum.begin (); it != m_spectrum.end (); it++)
+    {
+      both += m_abstract.count (*it);
+    }
+  os << "gateways " << m_gateways
+     << " spectrum " << m_spectrum.size ()
+     << " abstract " << m_abstract.size ()
+     << " both " << both
+     << " spectrum-only " << m_spectrum.size ()-both
+     << " abstract-only " << m_abstract.size ()-both
+     << " divergence " << GetDivergence () << std::endl;
+}
+
+} // namespace ns3
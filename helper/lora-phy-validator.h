@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_PHY_VALIDATOR_H
+#define LORA_PHY_VALIDATOR_H
+
+#include <ns3/object.h>
+#include <ns3/packet.h>
+#include <ns3/callback.h>
+#include <ostream>
+#include <set>
+
+namespace ns3 {
+
+class LoRaPhy;
+class LoRaGwPhy;
+class LoRaAbstractPhy;
+class LoRaAbstractGwPhy;
+
+/**
+ * \ingroup lora
+ *
+ * Runs the analytic PHY side by side with the spectrum PHY and compares the
+ * packets that every gateway receives.
+ *
+ * Every phy gets an analytic shadow on a LoRaAbstractChannel. Transmissions are
+ * mirrored to the shadow, only the spectrum phy talks to the device. This is meant
+ * for small topologies, all received packets are remembered.
+ */
+class LoRaPhyValidator : public Object
+{
+public:
+  /**
+   * Callback of a gateway phy for a received packet
+   */
+  typedef Callback<void, Ptr<Packet>, uint32_t, uint8_t, uint32_t, double> GwReceptionCallback;
+
+  LoRaPhyValidator ();
+  virtual ~LoRaPhyValidator ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Transmit on an end device phy and its shadow.
+   *
+   * \param phy the spectrum phy
+   * \param shadow the analytic phy
+   * \param packet the packet
+   * \return the result of the spectrum phy
+   */
+  static bool StartTx (Ptr<LoRaPhy> phy, Ptr<LoRaAbstractPhy> shadow, Ptr<Packet> packet);
+
+  /**
+   * Transmit on a gateway phy and its shadow.
+   *
+   * \param phy the spectrum phy
+   * \param shadow the analytic phy
+   * \param packet the packet
+   * \return the result of the spectrum phy
+   */
+  static bool StartGwTx (Ptr<LoRaGwPhy> phy, Ptr<LoRaAbstractGwPhy> shadow, Ptr<Packet> packet);
+
+  /**
+   * Compare the receptions of a gateway phy and its shadow.
+   * Set the callbacks of the device on the spectrum phy first.
+   *
+   * \param phy the spectrum phy
+   * \param shadow the analytic phy
+   * \param device the reception callback of the device
+   */
+  void Watch (Ptr<LoRaGwPhy> phy, Ptr<LoRaAbstractGwPhy> shadow, GwReceptionCallback device);
+
+  /**
+   * Get the fraction of the received packets that only one of both PHYs received.
+   *
+   * \return the divergence, 0 if both PHYs agree
+   */
+  double GetDivergence (void) const;
+
+  /**
+   * \param abstract true for the analytic PHY, false for the spectrum PHY
+   * \return the number of packets received by the gateways with that PHY
+   */
+  uint32_t GetReceptions (bool abstract) const;
+
+  /**
+   * Print the packets received by each PHY and the divergence.
+   *
+   * \param os the output stream
+   */
+  void Report (std::ostream &os) const;
+
+private:
+  /**
+   * Record a packet of the spectrum phy and pass it to the device.
+   */
+  static void SpectrumReceived (Ptr<LoRaPhyValidator> validator, uint32_t gateway, GwReceptionCallback device,
+                                Ptr<Packet> packet, uint32_t bandwidth, uint8_t spreading, uint32_t frequency, double rssi);
+
+  /**
+   * Record a packet of the analytic phy.
+   */
+  static void AbstractReceived (Ptr<LoRaPhyValidator> validator, uint32_t gateway,
+                                Ptr<Packet> packet, uint32_t bandwidth, uint8_t spreading, uint32_t frequency, double rssi);
+
+  uint32_t m_gateways; //!< number of watched gateways
+  std::set<std::pair<uint32_t, uint64_t> > m_spectrum; //!< (gateway, packet uid) received by the spectrum PHY
+  std::set<std::pair<uint32_t, uint64_t> > m_abstract; //!< (gateway, packet uid) received by the analytic PHY
+};
+
+} // namespace ns3
+
+#endif /* LORA_PHY_VALIDATOR_H */
@@ -79,6 +79,7 @@ LoRaRadioEnergyModelHelper::DoInstall (Ptr<NetDevice> device,
   //track transceiver state
   Ptr<LoRaPhy> LoRaPhy = LoRaDevice->GetPhy ();
   LoRaPhy -> TraceConnectWithoutContext ("StateValue",MakeCallback(&LoRaRadioEnergyModel::ChangeLoRaState, model));
+  LoRaPhy -> TraceConnectWithoutContext ("SkippedRx",MakeCallback(&LoRaRadioEnergyModel::ChargeSkippedRx, model));
 
   return model;
 }
@@ -0,0 +1,258 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-abstract-channel.h"
+#include "lora-phy.h"
+#include "lora-spectrum-channel.h"
+#include <ns3/mobility-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/net-device.h>
+#include <ns3/node.h>
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/uinteger.h>
+#include <ns3/pointer.h>
+#include <ns3/log.h>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaAbstractChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaAbstractChannel);
+
+TypeId
+LoRaAbstractChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaAbstractChannel")
+    .SetParent<Channel> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaAbstractChannel> ()
+    .AddAttribute ("MinRxPower",
+                   "Signals received below this power (dBm) are not handed to the receiver.",
+                   DoubleValue (-160.0),
+                   MakeDoubleAccessor (&LoRaAbstractChannel::m_minRxPowerDbm),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CacheLinkGain",
+                   "Remember the deterministic path loss between nodes with a ConstantPositionMobilityModel. "
+                   "Fading models (Nakagami, Jakes, random) are still sampled for every signal.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaAbstractChannel::m_cacheLinkGain),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxCachedLinks",
+                   "The link gain cache is emptied when it holds this many links.",
+                   UintegerValue (1000000),
+                   MakeUintegerAccessor (&LoRaAbstractChannel::m_maxCachedLinks),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PropagationLossModel",
+                   "The propagation loss model of every link.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaAbstractChannel::SetPropagationLossModel),
+                   MakePointerChecker<PropagationLossModel> ())
+    .AddAttribute ("PropagationDelayModel",
+                   "The propagation delay model of every link.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaAbstractChannel::m_propagationDelay),
+                   MakePointerChecker<PropagationDelayModel> ())
+  ;
+  return tid;
+}
+
+LoRaAbstractChannel::LoRaAbstractChannel ()
+{
+  NS_LOG_FUNCTION (this);
+  m_propagationLoss = 0;
+  m_fadingLoss = 0;
+  m_propagationDelay = 0;
+  m_minRxPowerDbm = -160.0;
+  m_cacheLinkGain = true;
+  m_maxCachedLinks = 1000000;
+}
+
+LoRaAbstractChannel::~LoRaAbstractChannel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaAbstractChannel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_receivers.clear ();
+  m_linkGain.clear ();
+  m_watched.clear ();
+  m_propagationLoss = 0;
+  m_fadingLoss = 0;
+  m_propagationDelay = 0;
+  Channel::DoDispose ();
+}
+
+void
+LoRaAbstractChannel::AddPhy (Ptr<LoRaPhy> phy, RxCallback rx)
+{
+  NS_LOG_FUNCTION (this << phy);
+  Receiver receiver;
+  receiver.phy = phy;
+  receiver.rx = rx;
+  m_receivers.push_back (receiver);
+}
+
+void
+LoRaAbstractChannel::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  LoRaSpectrumChannel::SplitPropagationLoss (loss, m_propagationLoss, m_fadingLoss);
+  m_linkGain.clear ();
+}
+
+void
+LoRaAbstractChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  m_propagationDelay = delay;
+}
+
+double
+LoRaAbstractChannel::GetLinkGain (Ptr<MobilityModel> txMobility, Ptr<MobilityModel> rxMobility)
+{
+  double gainDb = 0;
+  if (m_propagationLoss)
+    {
+      if (m_cacheLinkGain
+          && DynamicCast<ConstantPositionMobilityModel> (txMobility) != 0
+          && DynamicCast<ConstantPositionMobilityModel> (rxMobility) != 0)
+        {
+          std::pair<MobilityModel*,MobilityModel*> key = std::make_pair (PeekPointer (txMobility), PeekPointer (rxMobility));
+          std::map<std::pair<MobilityModel*,MobilityModel*>, double>::iterator it = m_linkGain.find (key);
+          if (it != m_linkGain.end ())
+            {
+              gainDb = it->second;
+            }
+          else
+            {
+              if (m_linkGain.size () >= m_maxCachedLinks)
+                {
+                  m_linkGain.clear ();
+                }
+              WatchMobility (txMobility);
+              WatchMobility (rxMobility);
+              gainDb = m_propagationLoss->CalcRxPower (0, txMobility, rxMobility);
+              m_linkGain[key] = gainDb;
+            }
+        }
+      else
+        {
+          gainDb = m_propagationLoss->CalcRxPower (0, txMobility, rxMobility);
+        }
+    }
+  if (m_fadingLoss)
+    {
+      gainDb = m_fadingLoss->CalcRxPower (gainDb, txMobility, rxMobility);
+    }
+  return gainDb;
+}
+
+void
+LoRaAbstractChannel::WatchMobility (Ptr<MobilityModel> mobility)
+{
+  if (m_watched.insert (PeekPointer (mobility)).second)
+    {
+      mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&LoRaAbstractChannel::CourseChanged, this));
+    }
+}
+
+void
+LoRaAbstractChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+  // forget all links of the node that moved
+  const MobilityModel *moved = PeekPointer (mobility);
+  std::map<std::pair<MobilityModel*,MobilityModel*>, double>::iterator it = m_linkGain.begin ();
+  while (it != m_linkGain.end ())
+    {
+      if (it->first.first == moved || it->first.second == moved)
+        {
+          m_linkGain.erase (it++);
+        }
+      else
+        {
+          it++;
+        }
+    }
+}
+
+void
+LoRaAbstractChannel::StartTx (Ptr<LoRaAbstractSignal> signal)
+{
+  NS_LOG_FUNCTION (this << signal);
+  Ptr<MobilityModel> txMobility = signal->txPhy->GetMobility ();
+  double txPowerDbm = 10*std::log10 (signal->power)+30;
+  for (std::vector<Receiver>::const_iterator it = m_receivers.begin (); it != m_receivers.end (); it++)
+    {
+      if (it->phy == signal->txPhy)
+        {
+          continue;
+        }
+      Ptr<MobilityModel> rxMobility = it->phy->GetMobility ();
+      double rxPowerDbm = txPowerDbm + GetLinkGain (txMobility, rxMobility);
+      if (rxPowerDbm < m_minRxPowerDbm)
+        {
+          continue;
+        }
+      double rxPower = std::pow (10.0, (rxPowerDbm-30)/10);
+      Time delay = Seconds (0);
+      if (m_propagationDelay)
+        {
+          delay = m_propagationDelay->GetDelay (txMobility, rxMobility);
+        }
+      Ptr<NetDevice> netDev = it->phy->GetDevice ();
+      if (netDev != 0 && netDev->GetNode () != 0)
+        {
+          Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), delay, &LoRaAbstractChannel::StartRx, this, it->rx, signal, rxPower);
+        }
+      else
+        {
+          Simulator::Schedule (delay, &LoRaAbstractChannel::StartRx, this, it->rx, signal, rxPower);
+        }
+    }
+}
+
+void
+LoRaAbstractChannel::StartRx (RxCallback rx, Ptr<const LoRaAbstractSignal> signal, double rxPower)
+{
+  NS_LOG_FUNCTION (this << signal << rxPower);
+  rx (signal, rxPower);
+}
+
+std::size_t
+LoRaAbstractChannel::GetNDevices (void) const
+{
+  return m_receivers.size ();
+}
+
+Ptr<NetDevice>
+LoRaAbstractChannel::GetDevice (std::size_t i) const
+{
+  NS_ASSERT (i < m_receivers.size ());
+  return m_receivers[i].phy->GetDevice ();
+}
+
+} // namespace ns3
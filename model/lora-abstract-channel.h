@@ -0,0 +1,172 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_ABSTRACT_CHANNEL_H
+#define LORA_ABSTRACT_CHANNEL_H
+
+#include <ns3/channel.h>
+#include <ns3/nstime.h>
+#include <ns3/packet.h>
+#include <ns3/callback.h>
+#include <ns3/simple-ref-count.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace ns3 {
+
+class LoRaPhy;
+class MobilityModel;
+class NetDevice;
+
+/**
+ * \ingroup lora
+ *
+ * A LoRa transmission as seen by the analytic PHY: scalar power, no spectrum.
+ */
+struct LoRaAbstractSignal : public SimpleRefCount<LoRaAbstractSignal>
+{
+  Ptr<Packet> packet; //!< the packet with its PHY header
+  Ptr<LoRaPhy> txPhy; //!< the transmitter
+  uint32_t channel; //!< carrier frequency (*100Hz)
+  uint8_t spreading; //!< spreading factor
+  uint32_t bandwidth; //!< bandwidth (Hz)
+  double power; //!< transmit power (W)
+  Time duration; //!< time on air
+};
+
+/**
+ * \ingroup lora
+ *
+ * Channel of the analytic link-abstraction PHY (LoRaAbstractPhy and LoRaAbstractGwPhy).
+ *
+ * It keeps a scalar gain per link instead of a spectrum per signal and hands
+ * every receiver the received power of a transmission after the propagation delay.
+ * Collisions, capture and the packet error rate are resolved by the receiving phys.
+ */
+class LoRaAbstractChannel : public Channel
+{
+public:
+  /**
+   * Callback of a receiver for an incoming signal and its received power (W)
+   */
+  typedef Callback<void, Ptr<const LoRaAbstractSignal>, double> RxCallback;
+
+  LoRaAbstractChannel ();
+  virtual ~LoRaAbstractChannel ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Attach a phy to the channel.
+   *
+   * \param phy the phy, its mobility is read at every transmission
+   * \param rx the function that receives the signals for this phy
+   */
+  void AddPhy (Ptr<LoRaPhy> phy, RxCallback rx);
+
+  /**
+   * Set the propagation loss model. The chain is split like in LoRaSpectrumChannel:
+   * the deterministic models can be cached per link, the fading models are sampled for every signal.
+   *
+   * \param loss the propagation loss model
+   */
+  void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+  /**
+   * Set the propagation delay model.
+   *
+   * \param delay the propagation delay model
+   */
+  void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+
+  /**
+   * Hand a transmission to all attached phys but the transmitter.
+   *
+   * \param signal the transmission
+   */
+  void StartTx (Ptr<LoRaAbstractSignal> signal);
+
+  /**
+   * Get the gain of a link. The deterministic part is cached between static nodes,
+   * the fading part is sampled every time.
+   *
+   * \param txMobility position of the transmitter
+   * \param rxMobility position of the receiver
+   * \return the gain in dB
+   */
+  double GetLinkGain (Ptr<MobilityModel> txMobility, Ptr<MobilityModel> rxMobility);
+
+  // inherited from Channel
+  virtual std::size_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * Hand a signal to a receiver once it has propagated
+   *
+   * \param rx the receive function of the phy
+   * \param signal the transmission
+   * \param rxPower the received power (W)
+   */
+  void StartRx (RxCallback rx, Ptr<const LoRaAbstractSignal> signal, double rxPower);
+
+  /**
+   * Start listening to the course changes of a mobility model, once.
+   *
+   * \param mobility the mobility model of a node with cached links
+   */
+  void WatchMobility (Ptr<MobilityModel> mobility);
+
+  /**
+   * Remove all cached links of a node that moved.
+   *
+   * \param mobility the mobility model that changed
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+
+  /**
+   * A phy attached to the channel
+   */
+  struct Receiver
+  {
+    Ptr<LoRaPhy> phy; //!< the phy
+    RxCallback rx; //!< its receive function
+  };
+
+  std::vector<Receiver> m_receivers; //!< all attached phys
+  Ptr<PropagationLossModel> m_propagationLoss; //!< deterministic part of the propagation loss
+  Ptr<PropagationLossModel> m_fadingLoss; //!< fading part of the propagation loss, sampled for every signal
+  Ptr<PropagationDelayModel> m_propagationDelay; //!< propagation delay model
+  double m_minRxPowerDbm; //!< signals below this power are not delivered
+  bool m_cacheLinkGain; //!< remember the deterministic gain between static nodes
+  uint32_t m_maxCachedLinks; //!< maximal size of the link gain cache
+  std::map<std::pair<MobilityModel*,MobilityModel*>, double> m_linkGain; //!< cached deterministic gains (dB)
+  std::set<MobilityModel*> m_watched; //!< mobility models whose course changes are followed
+};
+
+} // namespace ns3
+
+#endif /* LORA_ABSTRACT_CHANNEL_H */
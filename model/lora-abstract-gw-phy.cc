@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-abstract-gw-phy.h"
+#include "lora-phy-header.h"
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaAbstractGwPhy");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaAbstractGwPhy);
+
+TypeId
+LoRaAbstractGwPhy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaAbstractGwPhy")
+    .SetParent<LoRaGwPhy> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaAbstractGwPhy> ()
+    .AddAttribute ("CaptureThreshold",
+                   "A signal survives another signal of the same SF if it is this much stronger (dB)",
+                   DoubleValue (6.0),
+                   MakeDoubleAccessor (&LoRaAbstractGwPhy::m_captureThreshold),
+                   MakeDoubleChecker<double> ())
+  ;
+  return tid;
+}
+
+LoRaAbstractGwPhy::LoRaAbstractGwPhy ()
+{
+  NS_LOG_FUNCTION (this);
+  m_abstractChannel = 0;
+  m_captureThreshold = 6.0;
+}
+
+LoRaAbstractGwPhy::~LoRaAbstractGwPhy ()
+{
+  NS_LOG_FUNCTION (this);
+  m_abstractChannel = 0;
+}
+
+void
+LoRaAbstractGwPhy::SetAbstractChannel (Ptr<LoRaAbstractChannel> channel)
+{
+  NS_LOG_FUNCTION (this << channel);
+  m_abstractChannel = channel;
+  channel->AddPhy (this, MakeCallback (&LoRaAbstractGwPhy::StartAbstractRx, this));
+}
+
+bool
+LoRaAbstractGwPhy::StartTx (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  LoRaPhyHeader lh;
+  packet->AddHeader (lh);
+  Ptr<LoRaAbstractSignal> signal = Create<LoRaAbstractSignal> ();
+  signal->packet = packet;
+  signal->txPhy = this;
+  signal->channel = m_channelIndex;
+  signal->spreading = m_spreadingfactor;
+  signal->bandwidth = m_bandwidth;
+  signal->power = m_power;
+  signal->duration = Seconds ((packet->GetSize ())*8.0/(GetBitRate (m_spreadingfactor)));
+  Simulator::Schedule (signal->duration, &LoRaPhy::EndTx, this, packet->Copy ());
+  // the own transmission drowns everything that is being received
+  m_transmission = true;
+  m_receiver.LoseAll ();
+  m_abstractChannel->StartTx (signal);
+  return true;
+}
+
+void
+LoRaAbstractGwPhy::StartAbstractRx (Ptr<const LoRaAbstractSignal> signal, double power)
+{
+  NS_LOG_FUNCTION (this << signal << power);
+  m_receiver.SetCaptureThreshold (m_captureThreshold);
+  m_receiver.Arrive (signal, power);
+  if (m_transmission)
+    {
+      m_receiver.LoseAll ();
+    }
+  Simulator::Schedule (signal->duration, &LoRaAbstractGwPhy::EndAbstractRx, this, signal);
+  // a shadow of the validation mode only has a reception end callback
+  if (!m_ReceptionStart.IsNull ())
+    {
+      m_ReceptionStart ();
+    }
+}
+
+void
+LoRaAbstractGwPhy::EndAbstractRx (Ptr<const LoRaAbstractSignal> signal)
+{
+  NS_LOG_FUNCTION (this << signal);
+  LoRaAbstractReceiver::Reception reception = m_receiver.Depart (signal);
+  // like LoRaGwPhy, a packet with fewer than 5 bit errors is received
+  if (m_receiver.Decode (reception, m_k*m_temperature*signal->bandwidth, 5, m_random->GetValue ()))
+    {
+      if (signal->txPhy == 0)
+        {
+          // background traffic of a LoRaAggregateInterference is not forwarded
+          return;
+        }
+      Ptr<Packet> packet = signal->packet->Copy ();
+      LoRaPhyHeader lh;
+      packet->RemoveHeader (lh);
+      if (!m_ReceptionEnd.IsNull ())
+        {
+          m_ReceptionEnd (packet, signal->bandwidth, signal->spreading, signal->channel, reception.power);
+        }
+    }
+  else if (!m_ReceptionError.IsNull ())
+    {
+      m_ReceptionError ();
+    }
+}
+
+uint32_t
+LoRaAbstractGwPhy::GetReceptions ()
+{
+  return m_receiver.GetHealthy (0);
+}
+
+uint32_t
+LoRaAbstractGwPhy::GetReceptions (uint32_t freq)
+{
+  return m_receiver.GetHealthy (freq);
+}
+
+} // namespace ns3
@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_ABSTRACT_GW_PHY_H
+#define LORA_ABSTRACT_GW_PHY_H
+
+#include "lora-gw-phy.h"
+#include "lora-abstract-phy.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup lora
+ *
+ * Analytic link-abstraction PHY for gateways.
+ *
+ * It plugs into LoRaGwNetDevice like LoRaGwPhy, but is attached to a LoRaAbstractChannel.
+ * It receives all channels and SFs at once, resolves collisions with LoRaAbstractReceiver
+ * and decodes a packet with fewer than 5 bit errors, like LoRaGwPhy. Demodulator paths,
+ * SIC and the SIR matrix of LoRaGwPhy are not modelled.
+ */
+class LoRaAbstractGwPhy : public LoRaGwPhy
+{
+public:
+  LoRaAbstractGwPhy ();
+  virtual ~LoRaAbstractGwPhy ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Attach the phy to an analytic channel.
+   *
+   * \param channel the channel
+   */
+  void SetAbstractChannel (Ptr<LoRaAbstractChannel> channel);
+
+  /**
+   * Start the transmission of the given packet.
+   *
+   * \param packet the packet to send
+   * \return true
+   */
+  bool StartTx (Ptr<Packet> packet);
+
+  /**
+   * A signal arrives at the phy.
+   *
+   * \param signal the signal
+   * \param power received power (W)
+   */
+  void StartAbstractRx (Ptr<const LoRaAbstractSignal> signal, double power);
+
+  // inherited from LoRaGwPhy
+  virtual uint32_t GetReceptions ();
+  virtual uint32_t GetReceptions (uint32_t freq);
+
+private:
+  /**
+   * A signal ends at the phy.
+   *
+   * \param signal the signal
+   */
+  void EndAbstractRx (Ptr<const LoRaAbstractSignal> signal);
+
+  Ptr<LoRaAbstractChannel> m_abstractChannel; //!< the analytic channel
+  LoRaAbstractReceiver m_receiver; //!< signals at the phy
+  double m_captureThreshold; //!< capture threshold (dB)
+};
+
+} // namespace ns3
+
+#endif /* LORA_ABSTRACT_GW_PHY_H */
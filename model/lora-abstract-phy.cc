@@ -0,0 +1,293 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-abstract-phy.h"
+#include "lora-phy-header.h"
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/log.h>
+#include <cmath>
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaAbstractPhy");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaAbstractPhy);
+
+LoRaAbstractReceiver::LoRaAbstractReceiver ()
+{
+  m_captureDb = 6.0;
+  m_captureRatio = std::pow (10.0, m_captureDb/10);
+  m_errorModel = CreateObject<LoRaErrorModel> ();
+}
+
+void
+LoRaAbstractReceiver::SetCaptureThreshold (double sirDb)
+{
+  if (sirDb != m_captureDb)
+    {
+      m_captureDb = sirDb;
+      m_captureRatio = std::pow (10.0, sirDb/10);
+    }
+}
+
+bool
+LoRaAbstractReceiver::Overlap (const LoRaAbstractSignal &a, const LoRaAbstractSignal &b)
+{
+  return a.channel+a.bandwidth/200 > b.channel-b.bandwidth/200 && a.channel-a.bandwidth/200 < b.channel+b.bandwidth/200;
+}
+
+bool
+LoRaAbstractReceiver::Arrive (Ptr<const LoRaAbstractSignal> signal, double power)
+{
+  Reception arriving;
+  arriving.signal = signal;
+  arriving.power = power;
+  arriving.interference = 0.0;
+  arriving.lost = false;
+  for (std::vector<Reception>::iterator it = m_receptions.begin (); it != m_receptions.end (); it++)
+    {
+      if (!Overlap (*it->signal, *signal))
+        {
+          continue;
+        }
+      it->interference += power;
+      it->maxInterference = std::max (it->maxInterference, it->interference);
+      arriving.interference += it->power;
+      if (it->signal->spreading == signal->spreading && it->signal->bandwidth == signal->bandwidth)
+        {
+          // same SF: only a signal that is stronger by the capture threshold survives
+          if (it->power < m_captureRatio*power)
+            {
+              it->lost = true;
+            }
+          if (power < m_captureRatio*it->power)
+            {
+              arriving.lost = true;
+            }
+        }
+    }
+  arriving.maxInterference = arriving.interference;
+  m_receptions.push_back (arriving);
+  return !arriving.lost;
+}
+
+LoRaAbstractReceiver::Reception
+LoRaAbstractReceiver::Depart (Ptr<const LoRaAbstractSignal> signal)
+{
+  Reception departing;
+  departing.signal = 0;
+  for (uint32_t i = 0; i < m_receptions.size (); i++)
+    {
+      if (m_receptions[i].signal == signal)
+        {
+          departing = m_receptions[i];
+          m_receptions[i] = m_receptions.back ();
+          m_receptions.pop_back ();
+          break;
+        }
+    }
+  NS_ASSERT (departing.signal != 0);
+  for (std::vector<Reception>::iterator it = m_receptions.begin (); it != m_receptions.end (); it++)
+    {
+      if (Overlap (*it->signal, *signal))
+        {
+          it->interference = std::max (0.0, it->interference-departing.power);
+        }
+    }
+  return departing;
+}
+
+void
+LoRaAbstractReceiver::LoseAll (void)
+{
+  for (std::vector<Reception>::iterator it = m_receptions.begin (); it != m_receptions.end (); it++)
+    {
+      it->lost = true;
+    }
+}
+
+uint32_t
+LoRaAbstractReceiver::GetHealthy (uint32_t channel) const
+{
+  uint32_t healthy = 0;
+  for (std::vector<Reception>::const_iterator it = m_receptions.begin (); it != m_receptions.end (); it++)
+    {
+      if (!it->lost && (channel == 0 || it->signal->channel == channel))
+        {
+          healthy++;
+        }
+    }
+  return healthy;
+}
+
+bool
+LoRaAbstractReceiver::Decode (const Reception &reception, double noise, uint32_t maxBitErrors, double uniform) const
+{
+  if (reception.lost)
+    {
+      return false;
+    }
+  double sinr = reception.power/(noise+reception.maxInterference);
+  long double ber = m_errorModel->GetBER (sinr, reception.signal->spreading, reception.signal->bandwidth);
+  if (ber <= 0)
+    {
+      return true;
+    }
+  if (ber >= 1)
+    {
+      return false;
+    }
+  // probability of fewer than maxBitErrors bit errors in the packet
+  uint32_t bits = reception.signal->packet->GetSize ()*8;
+  double term = std::exp (bits*std::log1p (-(double) ber));
+  double success = 0.0;
+  for (uint32_t k = 0; k < maxBitErrors && k <= bits; k++)
+    {
+      success += term;
+      term *= (double)(bits-k)/(k+1)*(double) ber/(1-(double) ber);
+    }
+  return uniform < success;
+}
+
+TypeId
+LoRaAbstractPhy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaAbstractPhy")
+    .SetParent<LoRaPhy> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaAbstractPhy> ()
+    .AddAttribute ("CaptureThreshold",
+                   "A signal survives another signal of the same SF if it is this much stronger (dB)",
+                   DoubleValue (6.0),
+                   MakeDoubleAccessor (&LoRaAbstractPhy::m_captureThreshold),
+                   MakeDoubleChecker<double> ())
+  ;
+  return tid;
+}
+
+LoRaAbstractPhy::LoRaAbstractPhy ()
+{
+  NS_LOG_FUNCTION (this);
+  m_abstractChannel = 0;
+  m_current = 0;
+  m_captureThreshold = 6.0;
+}
+
+LoRaAbstractPhy::~LoRaAbstractPhy ()
+{
+  NS_LOG_FUNCTION (this);
+  m_abstractChannel = 0;
+  m_current = 0;
+}
+
+void
+LoRaAbstractPhy::SetAbstractChannel (Ptr<LoRaAbstractChannel> channel)
+{
+  NS_LOG_FUNCTION (this << channel);
+  m_abstractChannel = channel;
+  channel->AddPhy (this, MakeCallback (&LoRaAbstractPhy::StartAbstractRx, this));
+}
+
+bool
+LoRaAbstractPhy::StartTx (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  if (GetState () != LoRaTX)
+    {
+      return false;
+    }
+  Ptr<Packet> copy = packet->Copy ();
+  LoRaPhyHeader lh;
+  copy->AddHeader (lh);
+  Ptr<LoRaAbstractSignal> signal = Create<LoRaAbstractSignal> ();
+  signal->packet = copy;
+  signal->txPhy = this;
+  signal->channel = m_channelIndex;
+  signal->spreading = m_spreadingfactor;
+  signal->bandwidth = m_bandwidth;
+  signal->power = m_power;
+  signal->duration = Seconds ((copy->GetSize ())*8.0/(GetBitRate (m_spreadingfactor)));
+  Simulator::Schedule (signal->duration, &LoRaPhy::EndTx, this, copy->Copy ());
+  m_transmission = true;
+  m_receiver.LoseAll ();
+  m_abstractChannel->StartTx (signal);
+  return true;
+}
+
+void
+LoRaAbstractPhy::StartAbstractRx (Ptr<const LoRaAbstractSignal> signal, double power)
+{
+  NS_LOG_FUNCTION (this << signal << power);
+  m_receiver.SetCaptureThreshold (m_captureThreshold);
+  bool survives = m_receiver.Arrive (signal, power);
+  if (m_transmission)
+    {
+      // half duplex
+      m_receiver.LoseAll ();
+      survives = false;
+    }
+  Simulator::Schedule (signal->duration, &LoRaAbstractPhy::EndAbstractRx, this, signal);
+  if (survives && m_current == 0 && GetState () == LoRaRX && m_channelIndex == signal->channel
+      && m_bandwidth == signal->bandwidth && m_spreadingfactor == signal->spreading)
+    {
+      m_current = signal;
+      if (!m_ReceptionStart.IsNull ())
+        {
+          m_ReceptionStart ();
+        }
+    }
+}
+
+void
+LoRaAbstractPhy::EndAbstractRx (Ptr<const LoRaAbstractSignal> signal)
+{
+  NS_LOG_FUNCTION (this << signal);
+  LoRaAbstractReceiver::Reception reception = m_receiver.Depart (signal);
+  if (signal != m_current)
+    {
+      return;
+    }
+  m_current = 0;
+  if (GetState () != LoRaRX)
+    {
+      // the receive window was closed in the meantime
+      return;
+    }
+  // the end device drops a packet with a single bit error
+  if (m_receiver.Decode (reception, m_k*m_temperature*signal->bandwidth, 1, m_random->GetValue ()))
+    {
+      Ptr<Packet> packet = signal->packet->Copy ();
+      LoRaPhyHeader lh;
+      packet->RemoveHeader (lh);
+      if (!m_ReceptionEnd.IsNull ())
+        {
+          m_ReceptionEnd (packet, 0);
+        }
+    }
+  else if (!m_ReceptionError.IsNull ())
+    {
+      m_ReceptionError ();
+    }
+  ChangeState (LoRaIDLE);
+}
+
+} // namespace ns3
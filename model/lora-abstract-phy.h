@@ -0,0 +1,173 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_ABSTRACT_PHY_H
+#define LORA_ABSTRACT_PHY_H
+
+#include "lora-phy.h"
+#include "lora-abstract-channel.h"
+#include "lora-error-model.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lora
+ *
+ * Collision and error bookkeeping of the analytic PHY, shared by the end device
+ * and the gateway.
+ *
+ * Signals with overlapping channels interfere with their full power. Signals of
+ * the same SF and bandwidth collide: the stronger one survives if it is CaptureThreshold
+ * above the other, otherwise both are lost. A surviving signal is decoded with
+ * the packet error rate of its worst SINR.
+ */
+class LoRaAbstractReceiver
+{
+public:
+  /**
+   * A signal at the receiver
+   */
+  struct Reception
+  {
+    Ptr<const LoRaAbstractSignal> signal; //!< the signal
+    double power; //!< received power (W)
+    double interference; //!< current power of the overlapping signals (W)
+    double maxInterference; //!< highest interference during the signal (W)
+    bool lost; //!< lost in a collision
+  };
+
+  LoRaAbstractReceiver ();
+
+  /**
+   * \param sirDb the ratio a signal needs over another of the same SF to survive
+   */
+  void SetCaptureThreshold (double sirDb);
+
+  /**
+   * Add an arriving signal and resolve its collisions.
+   *
+   * \param signal the signal
+   * \param power received power (W)
+   * \return true if the signal survived the collisions so far
+   */
+  bool Arrive (Ptr<const LoRaAbstractSignal> signal, double power);
+
+  /**
+   * Remove a signal that ends.
+   *
+   * \param signal the signal
+   * \return the reception of the signal
+   */
+  Reception Depart (Ptr<const LoRaAbstractSignal> signal);
+
+  /**
+   * Lose all signals at the receiver, for example when it starts to transmit.
+   */
+  void LoseAll (void);
+
+  /**
+   * Get the number of signals that were not lost yet.
+   *
+   * \param channel only count this channel, 0 for all channels
+   * \return the number of healthy receptions
+   */
+  uint32_t GetHealthy (uint32_t channel) const;
+
+  /**
+   * Decide whether a finished reception is decoded.
+   *
+   * \param reception the finished reception
+   * \param noise thermal noise in the band of the signal (W)
+   * \param maxBitErrors number of bit errors from which the packet is lost
+   * \param uniform a uniform sample in [0,1)
+   * \return true if the packet is received
+   */
+  bool Decode (const Reception &reception, double noise, uint32_t maxBitErrors, double uniform) const;
+
+private:
+  /**
+   * \return true if the channels of both signals overlap
+   */
+  static bool Overlap (const LoRaAbstractSignal &a, const LoRaAbstractSignal &b);
+
+  std::vector<Reception> m_receptions; //!< signals at the receiver
+  double m_captureDb; //!< capture threshold (dB)
+  double m_captureRatio; //!< linear capture threshold
+  Ptr<LoRaErrorModel> m_errorModel; //!< BER of a SINR, from the shared tables
+};
+
+/**
+ * \ingroup lora
+ *
+ * Analytic link-abstraction PHY for end devices.
+ *
+ * It plugs into LoRaNetDevice like LoRaPhy, but is attached to a LoRaAbstractChannel
+ * and keeps only the scalar received power of every signal. It schedules a single
+ * event per received signal.
+ */
+class LoRaAbstractPhy : public LoRaPhy
+{
+public:
+  LoRaAbstractPhy ();
+  virtual ~LoRaAbstractPhy ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Attach the phy to an analytic channel.
+   *
+   * \param channel the channel
+   */
+  void SetAbstractChannel (Ptr<LoRaAbstractChannel> channel);
+
+  /**
+   * Start the transmission of the given packet.
+   *
+   * \param packet the packet to send
+   * \return true if the phy was in LoRaTX
+   */
+  bool StartTx (Ptr<Packet> packet);
+
+  /**
+   * A signal arrives at the phy.
+   *
+   * \param signal the signal
+   * \param power received power (W)
+   */
+  void StartAbstractRx (Ptr<const LoRaAbstractSignal> signal, double power);
+
+private:
+  /**
+   * A signal ends at the phy.
+   *
+   * \param signal the signal
+   */
+  void EndAbstractRx (Ptr<const LoRaAbstractSignal> signal);
+
+  Ptr<LoRaAbstractChannel> m_abstractChannel; //!< the analytic channel
+  LoRaAbstractReceiver m_receiver; //!< signals at the phy
+  Ptr<const LoRaAbstractSignal> m_current; //!< the signal being received
+  double m_captureThreshold; //!< capture threshold (dB)
+};
+
+} // namespace ns3
+
+#endif /* LORA_ABSTRACT_PHY_H */
@@ -0,0 +1,339 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-aggregate-interference.h"
+#include "lora-gw-phy.h"
+#include "lora-abstract-gw-phy.h"
+#include "lora-phy-header.h"
+#include "lora-spectrum-signal-parameters.h"
+#include <ns3/spectrum-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/net-device.h>
+#include <ns3/node.h>
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <ns3/pointer.h>
+#include <ns3/log.h>
+#include <cmath>
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaAggregateInterference");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaAggregateInterference);
+
+TypeId
+LoRaAggregateInterference::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaAggregateInterference")
+    .SetParent<SpectrumPhy> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaAggregateInterference> ()
+    .AddAttribute ("PropagationLossModel",
+                   "The propagation loss model between the devices and the gateways.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaAggregateInterference::m_propagationLoss),
+                   MakePointerChecker<PropagationLossModel> ())
+    .AddAttribute ("TxPower",
+                   "Transmit power of the devices (dBm)",
+                   DoubleValue (14.0),
+                   MakeDoubleAccessor (&LoRaAggregateInterference::m_txPower),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("MinRxPower",
+                   "Devices received below this power (dBm) at all gateways are not kept.",
+                   DoubleValue (-150.0),
+                   MakeDoubleAccessor (&LoRaAggregateInterference::m_minRxPower),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("PacketSize",
+                   "Size of a packet of the devices without the PHY header (bytes)",
+                   UintegerValue (30),
+                   MakeUintegerAccessor (&LoRaAggregateInterference::m_packetSize),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+LoRaAggregateInterference::LoRaAggregateInterference ()
+{
+  NS_LOG_FUNCTION (this);
+  m_propagationLoss = 0;
+  m_position = CreateObject<ConstantPositionMobilityModel> ();
+  m_uniform = CreateObject<UniformRandomVariable> ();
+  m_interArrival = CreateObject<ExponentialRandomVariable> ();
+  m_txPower = 14.0;
+  m_minRxPower = -150.0;
+  m_packetSize = 30;
+  m_population = 0;
+  m_audible = 0;
+  m_bursts = 0;
+}
+
+LoRaAggregateInterference::~LoRaAggregateInterference ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaAggregateInterference::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_gateways.clear ();
+  m_processes.clear ();
+  m_propagationLoss = 0;
+  m_position = 0;
+  m_uniform = 0;
+  m_interArrival = 0;
+  SpectrumPhy::DoDispose ();
+}
+
+void
+LoRaAggregateInterference::AddGateway (Ptr<LoRaGwPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  NS_ASSERT_MSG (m_processes.empty (), "add the gateways before the devices");
+  m_gateways.push_back (phy);
+}
+
+double
+LoRaAggregateInterference::GetRxPower (const Vector &position)
+{
+  m_position->SetPosition (position);
+  double best = -1e9;
+  for (std::vector<Ptr<LoRaGwPhy> >::const_iterator it = m_gateways.begin (); it != m_gateways.end (); it++)
+    {
+      double rxPower = m_txPower;
+      if (m_propagationLoss != 0)
+        {
+          rxPower = m_propagationLoss->CalcRxPower (m_txPower, m_position, (*it)->GetMobility ());
+        }
+      best = std::max (best, rxPower);
+    }
+  return best;
+}
+
+bool
+LoRaAggregateInterference::AddDevice (const Vector &position, uint32_t channel, uint8_t sf, uint32_t bandwidth, double interval)
+{
+  NS_LOG_FUNCTION (this << position << channel << (uint32_t) sf << bandwidth << interval);
+  NS_ASSERT (interval > 0);
+  m_population++;
+  m_position->SetPosition (position);
+  std::vector<float> rxPower;
+  bool audible = false;
+  for (std::vector<Ptr<LoRaGwPhy> >::const_iterator it = m_gateways.begin (); it != m_gateways.end (); it++)
+    {
+      double rxPowerDbm = m_txPower;
+      if (m_propagationLoss != 0)
+        {
+          rxPowerDbm = m_propagationLoss->CalcRxPower (m_txPower, m_position, (*it)->GetMobility ());
+        }
+      if (rxPowerDbm < m_minRxPower)
+        {
+          rxPower.push_back (0.0);
+        }
+      else
+        {
+          rxPower.push_back (std::pow (10.0, (rxPowerDbm-30)/10));
+          audible = true;
+        }
+    }
+  if (!audible)
+    {
+      // its bursts would not be seen by any gateway
+      return false;
+    }
+  m_audible++;
+  std::pair<std::pair<uint32_t,uint8_t>,uint32_t> key = std::make_pair (std::make_pair (channel, sf), bandwidth);
+  ProcessMap::iterator it = m_processes.find (key);
+  if (it == m_processes.end ())
+    {
+      Process process;
+      process.channel = channel;
+      process.spreading = sf;
+      process.bandwidth = bandwidth;
+      LoRaPhyHeader lh;
+      double bitRate = std::round (bandwidth*sf/std::pow (2.0, sf));
+      process.duration = Seconds ((m_packetSize+lh.GetSerializedSize ())*8.0/bitRate);
+      process.rate = 0.0;
+      process.unitPsd = CreateUnitPsd (channel, bandwidth);
+      it = m_processes.insert (std::make_pair (key, process)).first;
+    }
+  it->second.rate += 1.0/interval;
+  it->second.cumulativeRate.push_back (it->second.rate);
+  it->second.rxPower.insert (it->second.rxPower.end (), rxPower.begin (), rxPower.end ());
+  return true;
+}
+
+void
+LoRaAggregateInterference::Start (Time start)
+{
+  NS_LOG_FUNCTION (this << start);
+  for (ProcessMap::iterator it = m_processes.begin (); it != m_processes.end (); it++)
+    {
+      NS_LOG_DEBUG ("process " << it->second.channel << " SF" << (uint32_t) it->second.spreading
+                    << ": " << it->second.cumulativeRate.size () << " devices, " << it->second.rate << " packets/s");
+      Time first = start + Seconds (m_interArrival->GetValue (1.0/it->second.rate, 0));
+      Simulator::Schedule (first-Simulator::Now (), &LoRaAggregateInterference::SendBurst, Ptr<LoRaAggregateInterference> (this), &it->second);
+    }
+}
+
+void
+LoRaAggregateInterference::SendBurst (Process *process)
+{
+  NS_LOG_FUNCTION (this);
+  m_bursts++;
+  // the sender of this burst, in proportion to the rate of every device
+  double draw = m_uniform->GetValue (0.0, process->rate);
+  uint32_t device = std::upper_bound (process->cumulativeRate.begin (), process->cumulativeRate.end (), draw)-process->cumulativeRate.begin ();
+  device = std::min (device, (uint32_t) process->cumulativeRate.size ()-1);
+  Ptr<Packet> packet = Create<Packet> (m_packetSize);
+  LoRaPhyHeader lh;
+  packet->AddHeader (lh);
+  for (uint32_t g = 0; g < m_gateways.size (); g++)
+    {
+      double rxPower = process->rxPower[device*m_gateways.size ()+g];
+      if (rxPower <= 0)
+        {
+          continue;
+        }
+      Ptr<LoRaGwPhy> gateway = m_gateways[g];
+      uint32_t context = Simulator::GetContext ();
+      if (gateway->GetDevice () != 0 && gateway->GetDevice ()->GetNode () != 0)
+        {
+          context = gateway->GetDevice ()->GetNode ()->GetId ();
+        }
+      Ptr<LoRaAbstractGwPhy> abstractGateway = DynamicCast<LoRaAbstractGwPhy> (gateway);
+      if (abstractGateway != 0)
+        {
+          // a signal without transmitter is not forwarded by the gateway
+          Ptr<LoRaAbstractSignal> signal = Create<LoRaAbstractSignal> ();
+          signal->packet = packet;
+          signal->txPhy = 0;
+          signal->channel = process->channel;
+          signal->spreading = process->spreading;
+          signal->bandwidth = process->bandwidth;
+          signal->power = std::pow (10.0, (m_txPower-30)/10);
+          signal->duration = process->duration;
+          Simulator::ScheduleWithContext (context, Seconds (0), &LoRaAbstractGwPhy::StartAbstractRx, abstractGateway, signal, rxPower);
+          continue;
+        }
+      Ptr<LoRaSpectrumSignalParameters> params = Create<LoRaSpectrumSignalParameters> ();
+      params->packet = packet->Copy ();
+      params->duration = process->duration;
+      params->txPhy = this;
+      params->txAntenna = 0;
+      params->SetChannel (process->channel);
+      params->SetSpreading (process->spreading);
+      params->SetBandwidth (process->bandwidth);
+      params->SetBer (0);
+      Ptr<SpectrumValue> psd = Create<SpectrumValue> (*process->unitPsd);
+      *psd *= rxPower;
+      params->psd = psd;
+      Simulator::ScheduleWithContext (context, Seconds (0), &LoRaGwPhy::StartRx, gateway, params);
+    }
+  Simulator::Schedule (Seconds (m_interArrival->GetValue (1.0/process->rate, 0)), &LoRaAggregateInterference::SendBurst, Ptr<LoRaAggregateInterference> (this), process);
+}
+
+Ptr<const SpectrumValue>
+LoRaAggregateInterference::CreateUnitPsd (uint32_t channel, uint32_t bandwidth)
+{
+  // like NoiseIsm, the burst is expressed directly on the LoRa receiver grid
+  Ptr<const SpectrumModel> sm = LoRaPhy::GetDefaultRxSpectrumModel ();
+  Ptr<SpectrumValue> psd = Create<SpectrumValue> (sm);
+  double fl = channel*100.0-bandwidth/2.0;
+  double fh = channel*100.0+bandwidth/2.0;
+  uint32_t i = 0;
+  for (Bands::const_iterator it = sm->Begin (); it != sm->End (); it++, i++)
+    {
+      double overlap = std::min (fh, it->fh)-std::max (fl, it->fl);
+      if (overlap > 0)
+        {
+          (*psd)[i] = overlap/(it->fh-it->fl)/bandwidth;
+        }
+    }
+  return psd;
+}
+
+uint32_t
+LoRaAggregateInterference::GetPopulation (void) const
+{
+  return m_population;
+}
+
+uint32_t
+LoRaAggregateInterference::GetAudible (void) const
+{
+  return m_audible;
+}
+
+uint64_t
+LoRaAggregateInterference::GetBursts (void) const
+{
+  return m_bursts;
+}
+
+void
+LoRaAggregateInterference::SetDevice (Ptr<NetDevice> d)
+{
+}
+
+Ptr<NetDevice>
+LoRaAggregateInterference::GetDevice () const
+{
+  return 0;
+}
+
+void
+LoRaAggregateInterference::SetMobility (Ptr<MobilityModel> m)
+{
+}
+
+Ptr<MobilityModel>
+LoRaAggregateInterference::GetMobility ()
+{
+  return 0;
+}
+
+void
+LoRaAggregateInterference::SetChannel (Ptr<SpectrumChannel> c)
+{
+}
+
+Ptr<const SpectrumModel>
+LoRaAggregateInterference::GetRxSpectrumModel () const
+{
+  return LoRaPhy::GetDefaultRxSpectrumModel ();
+}
+
+Ptr<AntennaModel>
+LoRaAggregateInterference::GetRxAntenna ()
+{
+  return 0;
+}
+
+void
+LoRaAggregateInterference::StartRx (Ptr<SpectrumSignalParameters> params)
+{
+  // the population is only a source
+}
+
+} // namespace ns3
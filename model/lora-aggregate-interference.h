@@ -0,0 +1,174 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_AGGREGATE_INTERFERENCE_H
+#define LORA_AGGREGATE_INTERFERENCE_H
+
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/vector.h>
+#include <ns3/nstime.h>
+#include <vector>
+#include <map>
+
+namespace ns3 {
+
+class LoRaGwPhy;
+class MobilityModel;
+class AntennaModel;
+class NetDevice;
+
+/**
+ * \ingroup lora
+ *
+ * Uplink interference of a device population that is not simulated in detail.
+ *
+ * The devices are only kept as their received power at the gateways under study.
+ * Per (channel, SF, bandwidth) their packets form a Poisson process with the summed
+ * rate of the devices. Every burst is sent by a device drawn in proportion to its
+ * rate, so the received power follows the distribution given by the positions and
+ * one burst reaches all gateways with the power of the same device. The bursts are
+ * LoRa signals and collide with the detailed devices, but gateways do not forward
+ * them. Devices below MinRxPower at every gateway are not kept.
+ */
+class LoRaAggregateInterference : public SpectrumPhy
+{
+public:
+  LoRaAggregateInterference ();
+  virtual ~LoRaAggregateInterference ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Add a gateway under study, before any device is added.
+   *
+   * \param phy the phy of the gateway, a LoRaAbstractGwPhy gets analytic signals
+   */
+  void AddGateway (Ptr<LoRaGwPhy> phy);
+
+  /**
+   * Get the strongest received power of a position at the gateways.
+   *
+   * \param position position of a device
+   * \return received power in dBm
+   */
+  double GetRxPower (const Vector &position);
+
+  /**
+   * Add a device of the population.
+   *
+   * \param position position of the device
+   * \param channel carrier frequency (*100Hz)
+   * \param sf spreading factor
+   * \param bandwidth bandwidth (Hz)
+   * \param interval mean time between its packets (s)
+   * \return false if no gateway hears the device
+   */
+  bool AddDevice (const Vector &position, uint32_t channel, uint8_t sf, uint32_t bandwidth, double interval);
+
+  /**
+   * Start the bursts of all processes.
+   *
+   * \param start time of the first possible burst
+   */
+  void Start (Time start);
+
+  /**
+   * \return the number of devices added, heard or not
+   */
+  uint32_t GetPopulation (void) const;
+
+  /**
+   * \return the number of devices kept
+   */
+  uint32_t GetAudible (void) const;
+
+  /**
+   * \return the number of bursts sent
+   */
+  uint64_t GetBursts (void) const;
+
+  // inherited from SpectrumPhy
+  void SetDevice (Ptr<NetDevice> d);
+  Ptr<NetDevice> GetDevice () const;
+  void SetMobility (Ptr<MobilityModel> m);
+  Ptr<MobilityModel> GetMobility ();
+  void SetChannel (Ptr<SpectrumChannel> c);
+  Ptr<const SpectrumModel> GetRxSpectrumModel () const;
+  Ptr<AntennaModel> GetRxAntenna ();
+  void StartRx (Ptr<SpectrumSignalParameters> params);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * The devices of one channel, SF and bandwidth
+   */
+  struct Process
+  {
+    uint32_t channel; //!< carrier frequency (*100Hz)
+    uint8_t spreading; //!< spreading factor
+    uint32_t bandwidth; //!< bandwidth (Hz)
+    Time duration; //!< time on air of a packet
+    double rate; //!< summed packet rate of the devices (1/s)
+    std::vector<double> cumulativeRate; //!< running sum of the device rates, to draw a device
+    std::vector<float> rxPower; //!< received power (W) of every device at every gateway, device major
+    Ptr<const SpectrumValue> unitPsd; //!< received PSD of 1 W on the LoRa grid
+  };
+
+  typedef std::map<std::pair<std::pair<uint32_t,uint8_t>,uint32_t>, Process> ProcessMap;
+
+  /**
+   * Send a burst of a process and schedule the next one.
+   * This function is meant to be scheduled.
+   *
+   * \param process the process
+   */
+  void SendBurst (Process *process);
+
+  /**
+   * Create the PSD of a 1 W signal on the LoRa receiver grid.
+   *
+   * \param channel carrier frequency (*100Hz)
+   * \param bandwidth bandwidth (Hz)
+   * \return the PSD
+   */
+  static Ptr<const SpectrumValue> CreateUnitPsd (uint32_t channel, uint32_t bandwidth);
+
+  std::vector<Ptr<LoRaGwPhy> > m_gateways; //!< the gateways under study
+  ProcessMap m_processes; //!< one process per channel, SF and bandwidth
+  Ptr<PropagationLossModel> m_propagationLoss; //!< propagation loss model of the population
+  Ptr<MobilityModel> m_position; //!< reused to compute the gain of every device
+  Ptr<UniformRandomVariable> m_uniform; //!< draws the device of a burst
+  Ptr<ExponentialRandomVariable> m_interArrival; //!< time between bursts
+  double m_txPower; //!< transmit power of the devices (dBm)
+  double m_minRxPower; //!< devices below this power at all gateways are dropped (dBm)
+  uint32_t m_packetSize; //!< size of a packet without PHY header (bytes)
+  uint32_t m_population; //!< devices added
+  uint32_t m_audible; //!< devices kept
+  uint64_t m_bursts; //!< bursts sent
+};
+
+} // namespace ns3
+
+#endif /* LORA_AGGREGATE_INTERFERENCE_H */
@@ -0,0 +1,51 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-channel-plan.h"
+
+namespace ns3 {
+
+LoRaChannelPlan::LoRaChannelPlan ()
+{
+  static const uint32_t defaultFrequencies [CHANNELS] = {8681000,8683000,8685000,8681000,8683000,8685000,0,0,0,0,0,0,0,0,0,0};
+  for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+      available[i] = i < 3;
+      frequencies[i] = defaultFrequencies[i];
+      maxDatarate[i] = 5;
+      minDatarate[i] = 0;
+    }
+}
+
+Ptr<LoRaChannelPlan>
+LoRaChannelPlan::GetDefault (void)
+{
+  // this reference keeps the default shared, so a device never changes it in place
+  static Ptr<LoRaChannelPlan> plan = Create<LoRaChannelPlan> ();
+  return plan;
+}
+
+Ptr<LoRaChannelPlan>
+LoRaChannelPlan::Copy (void) const
+{
+  return Create<LoRaChannelPlan> (*this);
+}
+
+} // namespace ns3
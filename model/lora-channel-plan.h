@@ -0,0 +1,66 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_CHANNEL_PLAN_H
+#define LORA_CHANNEL_PLAN_H
+
+#include <ns3/simple-ref-count.h>
+#include <ns3/ptr.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lora
+ *
+ * Channels and data rate limits of an end device.
+ *
+ * All devices share the EU868 plan of GetDefault. A device copies the plan the
+ * first time a MAC command changes it (copy-on-write), see LoRaNetDevice::GetWritablePlan.
+ */
+class LoRaChannelPlan : public SimpleRefCount<LoRaChannelPlan>
+{
+public:
+  static const uint8_t CHANNELS = 16; //!< channels of a plan
+
+  /**
+   * Create the EU868 plan: the 3 default channels enabled, DR0 to DR5 on every channel.
+   */
+  LoRaChannelPlan ();
+
+  /**
+   * \return the EU868 plan shared by all devices that did not change theirs
+   */
+  static Ptr<LoRaChannelPlan> GetDefault (void);
+
+  /**
+   * \return a copy that is not shared
+   */
+  Ptr<LoRaChannelPlan> Copy (void) const;
+
+  bool available [CHANNELS]; //!< the channel is enabled
+  uint32_t frequencies [CHANNELS]; //!< carrier frequency of every channel (*100Hz), 0 if not defined
+  uint16_t maxDatarate [CHANNELS]; //!< max data rate to use on every channel
+  uint16_t minDatarate [CHANNELS]; //!< min data rate to use on every channel
+};
+
+} // namespace ns3
+
+#endif /* LORA_CHANNEL_PLAN_H */
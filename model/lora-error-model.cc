@@ -20,7 +20,10 @@
 #include "lora-error-model.h"
 #include <ns3/log.h>
 
+#include <ns3/boolean.h>
+
 #include <cmath>
+#include <map>
 
 namespace ns3 {
 
@@ -33,17 +36,118 @@ namespace ns3 {
 			static TypeId tid = TypeId ("ns3::LoRaErrorModel")
 				.SetParent<Object> ()
 				.AddConstructor<LoRaErrorModel> ()
+				.AddAttribute ("LookupTable",
+						"Interpolate the BER in precomputed tables instead of evaluating the model for every SNR",
+						BooleanValue (true),
+						MakeBooleanAccessor (&LoRaErrorModel::m_lookupTable),
+						MakeBooleanChecker ())
 				;
 			return tid;
 		}
 
+	const double LoRaErrorModel::TABLE_MIN_DB = -30.0;
+	const double LoRaErrorModel::TABLE_MAX_DB = 30.0;
+	const double LoRaErrorModel::TABLE_STEP_DB = 0.01;
+
 	LoRaErrorModel::LoRaErrorModel (void)
 	{
-
+		m_lookupTable = true;
 	}
 
 	long double 
 		LoRaErrorModel::GetBER (double snr, uint16_t spreading, int bandwidth) const
+		{
+			if (m_lookupTable)
+			{
+				const BerTable *table = GetTable (spreading, bandwidth);
+				if (table != 0)
+				{
+					return LookUp (table, snr, spreading, bandwidth);
+				}
+			}
+			return GetExactBER (snr, spreading, bandwidth);
+		}
+
+	void
+		LoRaErrorModel::GetBER (const std::vector<double> &snr, uint16_t spreading, int bandwidth, std::vector<long double> &ber) const
+		{
+			ber.resize (snr.size ());
+			// the table is the same for the whole series
+			const BerTable *table = m_lookupTable ? GetTable (spreading, bandwidth) : 0;
+			for (uint32_t i = 0; i < snr.size (); i++)
+			{
+				ber[i] = table != 0 ? LookUp (table, snr[i], spreading, bandwidth) : GetExactBER (snr[i], spreading, bandwidth);
+			}
+		}
+
+	const LoRaErrorModel::BerTable *
+		LoRaErrorModel::GetTable (uint16_t spreading, int bandwidth)
+		{
+			if (spreading < 7 || spreading > 12 || (bandwidth != 125000 && bandwidth != 250000 && bandwidth != 500000))
+			{
+				return 0;
+			}
+			static std::map<std::pair<uint16_t,int>, BerTable> tables;
+			std::pair<uint16_t,int> key = std::make_pair (spreading, bandwidth);
+			std::map<std::pair<uint16_t,int>, BerTable>::iterator it = tables.find (key);
+			if (it != tables.end ())
+			{
+				return &it->second;
+			}
+			NS_LOG_DEBUG ("new BER table for SF" << spreading << " " << bandwidth);
+			BerTable &table = tables[key];
+			// the root in the model is negative below this SNR
+			int bitrate = bandwidth*spreading/pow(2.0,spreading);
+			double threshold = (sqrt((double)spreading)*1.28-0.4)*bitrate/bandwidth/spreading;
+			table.threshold = 10*std::log10(threshold);
+			uint32_t n = std::floor((TABLE_MAX_DB-TABLE_MIN_DB)/TABLE_STEP_DB+0.5)+1;
+			table.logBer.resize (n);
+			for (uint32_t i = 0; i < n; i++)
+			{
+				double snrDb = TABLE_MIN_DB+i*TABLE_STEP_DB;
+				long double ber = GetExactBER (std::pow (10.0, snrDb/10), spreading, bandwidth);
+				table.logBer[i] = ber > 0 ? (double) logl (ber) : -HUGE_VAL;
+			}
+			return &table;
+		}
+
+	long double
+		LoRaErrorModel::LookUp (const BerTable *table, double snr, uint16_t spreading, int bandwidth)
+		{
+			if (snr <= 0)
+			{
+				return -1;
+			}
+			double snrDb = 10*std::log10(snr);
+			double position = (snrDb-TABLE_MIN_DB)/TABLE_STEP_DB;
+			if (position < 0 || position >= table->logBer.size ()-1)
+			{
+				return GetExactBER (snr, spreading, bandwidth);
+			}
+			uint32_t i = position;
+			double low = TABLE_MIN_DB+i*TABLE_STEP_DB;
+			if (low+TABLE_STEP_DB < table->threshold)
+			{
+				return 1;
+			}
+			if (low <= table->threshold+5*TABLE_STEP_DB)
+			{
+				// the model jumps to 1 at the threshold and is too steep just above it to interpolate
+				return GetExactBER (snr, spreading, bandwidth);
+			}
+			if (std::isinf (table->logBer[i+1]))
+			{
+				// the BER underflows within this interval
+				return std::isinf (table->logBer[i]) ? 0 : GetExactBER (snr, spreading, bandwidth);
+			}
+			double fraction = position-i;
+			double logBer = table->logBer[i]+fraction*(table->logBer[i+1]-table->logBer[i]);
+			// exp in double precision is much cheaper, as long as the BER does not underflow
+			return logBer > -700 ? (long double) std::exp (logBer) : expl (logBer);
+		}
+
+	long double 
+		LoRaErrorModel::GetExactBER (double snr, uint16_t spreading, int bandwidth)
 		{
 			//based on matlab model
 			int bitrate = bandwidth*spreading/pow(2.0,spreading);
@@ -73,4 +177,35 @@ namespace ns3 {
 			 }
 		}
 
+	uint32_t
+		LoRaErrorModel::GetBitErrors (long double ber, uint32_t bits, double uniform) const
+		{
+			if (bits == 0 || ber <= 0)
+			{
+				return 0;
+			}
+			if (ber >= 1)
+			{
+				return bits;
+			}
+			// probability of zero bit errors
+			long double pmf = powl (1.0L - ber, bits);
+			if (pmf <= 0)
+			{
+				// (1-ber)^bits underflows: the block is lost anyway, so the mean is accurate enough
+				return (uint32_t) roundl (bits*ber);
+			}
+			// walk the CDF: P(k+1) = P(k) * (bits-k)/(k+1) * ber/(1-ber)
+			long double ratio = ber/(1.0L-ber);
+			long double cdf = pmf;
+			uint32_t errors = 0;
+			while (uniform > cdf && errors < bits)
+			{
+				pmf *= (long double)(bits-errors)/(long double)(errors+1)*ratio;
+				errors++;
+				cdf += pmf;
+			}
+			return errors;
+		}
+
 } // namespace ns3
@@ -21,6 +21,7 @@
 #define LORA_ERROR_MODEL_H
 
 #include <ns3/object.h>
+#include <vector>
 
 namespace ns3 {
 
@@ -45,6 +46,12 @@ namespace ns3 {
 			/**
 			 * Return BER for given SNR.
 			 *
+			 * With the LookupTable attribute, SF7-SF12 at 125, 250 and 500 kHz are
+			 * interpolated in precomputed tables (log-linear on a 0.01 dB grid, relative
+			 * error below 5e-4 wherever the BER is above 1e-300; smaller BERs never give
+			 * a bit error). Other settings, SNRs outside the tables and SNRs just
+			 * above the lowest SNR of the model use the model itself.
+			 *
 			 * \return bit error rate
 			 * \param snr SNR expressed as a power ratio (i.e. not in dB)
 			 * \param spreading spreading factor used 
@@ -52,6 +59,78 @@ namespace ns3 {
 			 */
 			long double GetBER (double snr, uint16_t spreading,int bandwidth) const;
 
+			/**
+			 * Return the number of bit errors in a block of bits.
+			 *
+			 * The count is drawn from the binomial distribution B(bits,ber) by
+			 * inverting its CDF, so one uniform sample replaces the Bernoulli trial
+			 * per bit while keeping the same statistics.
+			 *
+			 * \return number of bit errors in the block
+			 * \param ber bit error rate as returned by GetBER
+			 * \param bits number of bits in the block
+			 * \param uniform a sample of U(0,1)
+			 */
+			uint32_t GetBitErrors (long double ber, uint32_t bits, double uniform) const;
+
+			/**
+			 * Return the BER of a series of SNRs with the same settings, e.g. the SINR
+			 * timeline of one reception.
+			 *
+			 * \param snr SNRs expressed as a power ratio
+			 * \param spreading spreading factor used
+			 * \param bandwidth used in this lora configuration
+			 * \param ber (out) bit error rate of every SNR, as returned by GetBER
+			 */
+			void GetBER (const std::vector<double> &snr, uint16_t spreading, int bandwidth, std::vector<long double> &ber) const;
+
+		private:
+			/**
+			 * BER of one spreading factor and bandwidth on a dB grid
+			 */
+			struct BerTable
+			{
+				double threshold; //!< lowest SNR (dB) at which the model is defined, the BER is 1 below
+				std::vector<double> logBer; //!< natural logarithm of the BER at every grid point
+			};
+
+			/**
+			 * Evaluate the model itself.
+			 *
+			 * \return bit error rate
+			 * \param snr SNR expressed as a power ratio
+			 * \param spreading spreading factor used
+			 * \param bandwidth used in this lora configuration
+			 */
+			static long double GetExactBER (double snr, uint16_t spreading, int bandwidth);
+
+			/**
+			 * Get the table of a spreading factor and bandwidth. Tables are shared by all
+			 * error models and built on first use.
+			 *
+			 * \return the table, or 0 if the settings are not tabulated
+			 * \param spreading spreading factor used
+			 * \param bandwidth used in this lora configuration
+			 */
+			static const BerTable * GetTable (uint16_t spreading, int bandwidth);
+
+			/**
+			 * Interpolate the BER in a table.
+			 *
+			 * \return bit error rate
+			 * \param table the table of the settings
+			 * \param snr SNR expressed as a power ratio
+			 * \param spreading spreading factor used
+			 * \param bandwidth used in this lora configuration
+			 */
+			static long double LookUp (const BerTable *table, double snr, uint16_t spreading, int bandwidth);
+
+			static const double TABLE_MIN_DB; //!< lowest SNR in the tables
+			static const double TABLE_MAX_DB; //!< highest SNR in the tables
+			static const double TABLE_STEP_DB; //!< grid step of the tables
+
+			bool m_lookupTable; //!< interpolate the BER in a table instead of evaluating the model
+
 
 	};
 
@@ -137,6 +137,8 @@ namespace ns3 {
 			}
 			packet->AddHeader (header);
 			m_pendingPackets.push_back (std::make_tuple (dest,packet));
+			// the window is only chosen in CheckAckSend, the device opens both from now on
+			NotifyDownlink (header.GetAddr (), Simulator::Now ());
 			m_macTxTrace(packet);
 			return true;
 		}
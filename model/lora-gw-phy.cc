@@ -35,7 +35,12 @@
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/uinteger.h>
+#include <ns3/enum.h>
+#include <ns3/trace-source-accessor.h>
 #include <cmath>
+#include <algorithm>
 namespace ns3 {
 
 	NS_LOG_COMPONENT_DEFINE ("LoRaGwPhy");
@@ -49,6 +54,51 @@ namespace ns3 {
 			static TypeId tid = TypeId ("ns3::LoRaGwPhy")
 				.SetParent<LoRaPhy> ()
 				.AddConstructor<LoRaGwPhy> ()
+				.AddAttribute ("DemodulatorPaths",
+						"Number of receptions that can be demodulated at the same time",
+						UintegerValue (8),
+						MakeUintegerAccessor (&LoRaGwPhy::m_nPaths),
+						MakeUintegerChecker<uint32_t> (1))
+				.AddAttribute ("PreambleLockSymbols",
+						"Number of preamble symbols after which a demodulator path locks on a reception",
+						UintegerValue (5),
+						MakeUintegerAccessor (&LoRaGwPhy::m_lockSymbols),
+						MakeUintegerChecker<uint32_t> ())
+				.AddAttribute ("SirMatrix",
+						"The signal to interference ratios spreading factors need to survive each other",
+						EnumValue (LoRaGwPhy::SIR_ORTHOGONAL),
+						MakeEnumAccessor (&LoRaGwPhy::SetSirMatrix, &LoRaGwPhy::GetSirMatrix),
+						MakeEnumChecker (LoRaGwPhy::SIR_ORTHOGONAL, "Orthogonal",
+								LoRaGwPhy::SIR_GOURSAUD, "Goursaud"))
+				.AddAttribute ("CaptureModel",
+						"How a collision between signals of the same spreading factor is resolved",
+						EnumValue (LoRaGwPhy::CAPTURE_POWER),
+						MakeEnumAccessor (&LoRaGwPhy::m_captureModel),
+						MakeEnumChecker (LoRaGwPhy::CAPTURE_POWER, "Power",
+								LoRaGwPhy::CAPTURE_PREAMBLE, "Preamble"))
+				.AddAttribute ("Sic",
+						"Decode signals lost in a collision after the stronger signal is decoded and cancelled",
+						BooleanValue (false),
+						MakeBooleanAccessor (&LoRaGwPhy::m_sic),
+						MakeBooleanChecker ())
+				.AddAttribute ("SicEfficiency",
+						"Fraction of the power of a decoded signal that is removed from the interference",
+						DoubleValue (0.9),
+						MakeDoubleAccessor (&LoRaGwPhy::m_sicEfficiency),
+						MakeDoubleChecker<double> (0.0, 1.0))
+				.AddAttribute ("SicIterations",
+						"Maximal number of successive cancellations needed to decode a signal",
+						UintegerValue (1),
+						MakeUintegerAccessor (&LoRaGwPhy::m_sicIterations),
+						MakeUintegerChecker<uint32_t> ())
+				.AddTraceSource ("BusyPaths",
+						"The number of locked demodulator paths",
+						MakeTraceSourceAccessor (&LoRaGwPhy::m_busyPaths),
+						"ns3::TracedValueCallback::Uint32")
+				.AddTraceSource ("PathExhausted",
+						"A reception is lost because all demodulator paths are busy",
+						MakeTraceSourceAccessor (&LoRaGwPhy::m_pathExhaustedTrace),
+						"ns3::LoRaGwPhy::PathExhaustedCallback")
 				;
 			return tid;
 		}
@@ -58,6 +108,18 @@ namespace ns3 {
 	{
 		NS_LOG_FUNCTION (this);
 		m_collisions = 0;
+		m_maxHalfBandwidth = 0;
+		m_healthyReceptions = 0;
+		m_nPaths = 8;
+		m_lockSymbols = 5;
+		m_busyPaths = 0;
+		m_pathExhaustions = 0;
+		m_captureModel = CAPTURE_POWER;
+		SetSirMatrix (SIR_ORTHOGONAL);
+		m_sic = false;
+		m_sicEfficiency = 0.9;
+		m_sicIterations = 1;
+		m_sicRecoveries = 0;
 	}
 
 	LoRaGwPhy::~LoRaGwPhy ()
@@ -70,9 +132,23 @@ namespace ns3 {
 		{
 		m_netDevice = 0;
 		m_mobility = 0;
+		m_slots.clear ();
+		m_paths.clear ();
+		m_pendingLocks.clear ();
+		m_sicWaiting.clear ();
+		m_blockerReferences.clear ();
+		m_sicOutcome.clear ();
 		LoRaPhy::DoDispose ();
 		}
 
+	void
+		LoRaGwPhy::SetChannel (Ptr<SpectrumChannel> c)
+		{
+			NS_LOG_FUNCTION (this);
+			c->AddRx(this);
+			m_channel = c;
+		}
+
 	void
 		LoRaGwPhy::SetReceptionEndCallback (Callback<void,Ptr<Packet>,uint32_t,uint8_t,uint32_t,double> callback)
 		{
@@ -104,9 +180,10 @@ namespace ns3 {
 			// transmit it
 			Simulator::Schedule(txParams->duration,&LoRaGwPhy::EndTx,this,packet->Copy());
 			// Add the current signal to the noise at the receiver
-			*m_receivingPower += *(GetFullTxPowerSpectralDensity(m_channelIndex,m_power));
+			Ptr<SpectrumValue> selfPsd = GetFullTxPowerSpectralDensity(m_channelIndex,m_power);
+			AddReceivingPower (selfPsd);
 			// And schedule it to stop
-			Simulator::Schedule(txParams->duration,&LoRaPhy::EndNoise,this,GetFullTxPowerSpectralDensity(m_channelIndex,m_power));
+			Simulator::Schedule(txParams->duration,&LoRaPhy::EndNoise,this,selfPsd);
 			// Start the transmission!
 			m_channel->StartTx(txParams);
 			// Notify that the PHY has started
@@ -117,72 +194,59 @@ namespace ns3 {
 		LoRaGwPhy::StartRx (Ptr<SpectrumSignalParameters> params)
 		{
 			NS_LOG_FUNCTION (this << params);
+			//signals far below the noise floor need no events at all
+			if (DropBelowSensitivity (params))
+			{
+				return;
+			}
 			//update BER
 			UpdateBer();
+			LockPendingPaths ();
 			// Check if params are from lora 
 			Ptr<LoRaSpectrumSignalParameters> sfParams = DynamicCast<LoRaSpectrumSignalParameters> (params);
 			// add power to received power
-			*m_receivingPower += *params->psd;
-			//Schedule the end of the noise
-			Simulator::Schedule(params->duration,&LoRaGwPhy::EndNoise,this,params->psd);
+			AddReceivingPower (params->psd);
+			//Schedule the end of the noise and of the reception at once
+			Simulator::Schedule(params->duration,&LoRaGwPhy::EndOfSignal,this,params);
 			m_ReceptionStart();
 			if (sfParams != 0){
 				//in this case if it is a lora packet arriving
-				//Schedule end of reception
-				Simulator::Schedule(sfParams->duration,&LoRaGwPhy::EndRx,this,sfParams);
 				uint32_t channel = sfParams->GetChannel();
 				uint32_t bandwidth = sfParams->GetBandwidth();
-				//uint8_t spreading = sfParams->GetSpreading();
-				//uint8_t error =0;
-				//Choose highest SNR if multiple
-				for (auto &i : m_params)
+				uint32_t sfClass = GetSfClass (sfParams);
+				m_maxHalfBandwidth = std::max (m_maxHalfBandwidth, bandwidth/200);
+				// the power in its band is all that is needed to resolve collisions
+				Reception arriving;
+				arriving.params = sfParams;
+				arriving.power = 0.0;
+				arriving.start = Simulator::Now ();
+				for (int k = (channel-868e4-bandwidth/200)/250+1; k < (channel-868e4+bandwidth/200)/250+1; k++)
 				{
-					//Check if spreading are orthogonal, if so, then there is no problem
-					if (2*i->GetBandwidth()/pow(2,i->GetSpreading()-2) == 2*sfParams->GetBandwidth()/pow(2,sfParams->GetSpreading()-2))
+					arriving.power += (*sfParams->psd)[k];
+				}
+				//Only overlapping channels can collide, and only the same SF class unless SFs are quasi-orthogonal
+				ReceptionSlots::iterator slot = m_interSf ? m_slots.begin () : m_slots.lower_bound (std::make_pair (sfClass, channel-bandwidth/200-m_maxHalfBandwidth));
+				for (; slot != m_slots.end () && (m_interSf || (slot->first.first == sfClass && slot->first.second < channel+bandwidth/200+m_maxHalfBandwidth)); slot++)
+				{
+					for (auto &i : slot->second)
 					{
 						//Check if bandwidths collide
-						if ( i->GetChannel()+i->GetBandwidth()/200> channel-bandwidth/200 && i->GetChannel()-i->GetBandwidth()/200 < channel+bandwidth/200)
+						if ( i.params->GetChannel()+i.params->GetBandwidth()/200> channel-bandwidth/200 && i.params->GetChannel()-i.params->GetBandwidth()/200 < channel+bandwidth/200)
 						{
-							m_collisions++;
-
-							double Poweri = 0.0;
-							double Powerj = 0.0;
-							//check which packets gets destroyed.
-							//datasheet says 6dB power difference -> power should be factor 4 higher.
-							for (uint8_t p = 0; p<25; p++){
-								Poweri += (*i->psd)[p];
-								Powerj += (*sfParams->psd)[p];
-							}
-							if (Poweri > 4*Powerj)
-							{
-								sfParams->SetBer(10);
-							}
-							else
-							{
-								if (Powerj > 4*Poweri)
-								{
-									i->SetBer(10);
-								}
-								else
-								{
-									m_collisions++;
-									i->SetBer(10);
-									sfParams->SetBer(10);
-								}
-							}
+							Collide (i, arriving);
 						}
 					}
 				}
-				// Check if we did not reach the maximal amount of concurrent receptions
-				if (GetReceptions () > 8)
+				// a demodulator path is needed once the preamble is detected
+				Time symbol = Seconds (std::pow (2.0, sfParams->GetSpreading())/bandwidth);
+				m_pendingLocks.insert (std::make_pair (Simulator::Now ()+std::min (symbol*m_lockSymbols, sfParams->duration), sfParams));
+				// put the sfParams in its slot.
+				m_slots[std::make_pair (sfClass, channel)].push_back(arriving);
+				if (sfParams->GetBer() == 0)
 				{
-					NS_LOG_DEBUG("TOO many messages in the queue. " << GetReceptions () << sfParams);
-					// we are receiving too many messages at this time. This one is impossible to track.
-					// Give it some bit errors such that it for sure does not arrive. Even though the SNR is good.
-					sfParams->SetBer (10);
+					m_healthyReceptions++;
+					m_healthyPerChannel[channel]++;
 				}
-				// push the sfParams in the queue. 
-				m_params.push_back(sfParams);
 			}
 			else
 			{
@@ -190,114 +254,449 @@ namespace ns3 {
 		}
 
 	uint32_t
-		LoRaGwPhy::GetCollisions()
+		LoRaGwPhy::GetSfClass (Ptr<LoRaSpectrumSignalParameters> params)
 		{
-			return m_collisions;
+			// bandwidth/2^SF is the chirp rate, scaled to an integer
+			NS_ASSERT (params->GetSpreading() <= 12);
+			return params->GetBandwidth() << (12-params->GetSpreading());
 		}
 
-	uint32_t 
-		LoRaGwPhy::GetReceptions()
+	void
+		LoRaGwPhy::SetLost (Ptr<LoRaSpectrumSignalParameters> params)
+		{
+			if (params->GetBer() == 0)
+			{
+				m_healthyReceptions--;
+				m_healthyPerChannel[params->GetChannel()]--;
+			}
+			params->SetBer(10);
+			// early abort, the path can demodulate another packet
+			FreePath (params);
+		}
+
+	void
+		LoRaGwPhy::SetSirMatrix (SirMatrix matrix)
 		{
-			uint8_t temp = 0;
-			for (auto &i : m_params)
+			NS_LOG_FUNCTION (this << matrix);
+			// rows: wanted SF7-SF12, columns: interfering SF7-SF12, in dB
+			static const double goursaud[6][6] = {
+				{6, -16, -18, -19, -19, -20},
+				{-24, 6, -20, -22, -22, -22},
+				{-27, -27, 6, -23, -25, -25},
+				{-30, -30, -30, 6, -26, -28},
+				{-33, -33, -33, -33, 6, -29},
+				{-36, -36, -36, -36, -36, 6}};
+			m_sirMatrix = matrix;
+			m_interSf = false;
+			for (uint8_t w = 0; w < 6; w++)
 			{
-				if(i->GetBer()==0)
+				for (uint8_t i = 0; i < 6; i++)
 				{
-					temp++;
+					if (matrix == SIR_GOURSAUD)
+					{
+						SetSirThreshold (w+7, i+7, goursaud[w][i]);
+					}
+					else
+					{
+						// the former 6 dB rule: the wanted signal must be 4 times stronger
+						m_sirRatio[w][i] = w == i ? 4.0 : 0.0;
+					}
 				}
 			}
-			return temp;
 		}
 
-	uint32_t 
-		LoRaGwPhy::GetReceptions(uint32_t freq)
+	LoRaGwPhy::SirMatrix
+		LoRaGwPhy::GetSirMatrix (void) const
+		{
+			return m_sirMatrix;
+		}
+
+	void
+		LoRaGwPhy::SetSirThreshold (uint8_t wanted, uint8_t interferer, double sirDb)
+		{
+			NS_LOG_FUNCTION (this << (uint32_t) wanted << (uint32_t) interferer << sirDb);
+			NS_ASSERT (wanted >= 7 && wanted <= 12 && interferer >= 7 && interferer <= 12);
+			m_sirRatio[wanted-7][interferer-7] = std::pow (10.0, sirDb/10);
+			if (wanted != interferer && m_sirRatio[wanted-7][interferer-7] > 0)
+			{
+				m_interSf = true;
+			}
+		}
+
+	bool
+		LoRaGwPhy::Survives (const Reception &wanted, const Reception &interferer) const
+		{
+			uint8_t w = wanted.params->GetSpreading();
+			uint8_t i = interferer.params->GetSpreading();
+			if (GetSfClass (wanted.params) == GetSfClass (interferer.params))
+			{
+				// the same chirp rate, also across bandwidths
+				return wanted.power > (w >= 7 ? m_sirRatio[w-7][w-7] : 4.0)*interferer.power;
+			}
+			if (wanted.params->GetBandwidth() != interferer.params->GetBandwidth() || w < 7 || i < 7)
+			{
+				return true;
+			}
+			return wanted.power > m_sirRatio[w-7][i-7]*interferer.power;
+		}
+
+	void
+		LoRaGwPhy::Collide (Reception &current, Reception &arriving)
 		{
-			uint8_t temp = 0;
-			for (auto &i : m_params)
+			bool currentSurvives = Survives (current, arriving);
+			bool arrivingSurvives = Survives (arriving, current);
+			if (GetSfClass (current.params) != GetSfClass (arriving.params))
 			{
-				if(i->GetBer()==0 && i->GetChannel() == freq)
+				if (!currentSurvives || !arrivingSurvives)
 				{
-					temp++;
+					m_collisions++;
 				}
 			}
-			return temp;
+			else
+			{
+				m_collisions++;
+				if (!currentSurvives && !arrivingSurvives)
+				{
+					m_collisions++;
+				}
+				if (m_captureModel == CAPTURE_PREAMBLE && arrivingSurvives && current.params->GetBer() < 10)
+				{
+					// the receiver only switches to the stronger signal while it is still in the preamble of the first one
+					Time symbol = Seconds (std::pow (2.0, current.params->GetSpreading())/current.params->GetBandwidth());
+					if (Simulator::Now () - current.start >= symbol*m_lockSymbols)
+					{
+						arrivingSurvives = false;
+					}
+				}
+			}
+			if (!currentSurvives && !(arrivingSurvives && Block (current, arriving)))
+			{
+				SetLost (current.params);
+			}
+			if (!arrivingSurvives && !(currentSurvives && Block (arriving, current)))
+			{
+				// not counted as healthy yet
+				arriving.params->SetBer(10);
+			}
+		}
+
+	bool
+		LoRaGwPhy::Block (Reception &victim, const Reception &blocker)
+		{
+			if (!m_sic || blocker.params->GetBer() >= 10)
+			{
+				return false;
+			}
+			Blocker b;
+			b.params = blocker.params;
+			b.power = blocker.power;
+			b.start = blocker.start;
+			victim.blockers.push_back (b);
+			m_blockerReferences[blocker.params]++;
+			return true;
+		}
+
+	uint32_t
+		LoRaGwPhy::GetSicRecoveries (void)
+		{
+			return m_sicRecoveries;
+		}
+
+	void
+		LoRaGwPhy::SetIfChannels (const std::vector<uint32_t> &channels)
+		{
+			NS_LOG_FUNCTION (this);
+			m_ifChannels = channels;
+		}
+
+	uint32_t
+		LoRaGwPhy::GetPathExhaustions (void)
+		{
+			return m_pathExhaustions;
+		}
+
+	void
+		LoRaGwPhy::LockPath (Ptr<LoRaSpectrumSignalParameters> params)
+		{
+			NS_LOG_FUNCTION (this << params);
+			// the reception may already be over or lost
+			ReceptionSlots::iterator slot = FindSlot (params);
+			if (params->GetBer() >= 10 || slot == m_slots.end () || FindReception (slot->second, params) == slot->second.end())
+			{
+				return;
+			}
+			if (!m_ifChannels.empty () && std::find (m_ifChannels.begin (), m_ifChannels.end (), params->GetChannel()) == m_ifChannels.end ())
+			{
+				// no IF chain is tuned to this channel
+				SetLost (params);
+				return;
+			}
+			if (m_paths.size () < m_nPaths)
+			{
+				m_paths.resize (m_nPaths);
+			}
+			for (uint32_t p = 0; p < m_nPaths; p++)
+			{
+				if (m_paths[p] == 0)
+				{
+					m_paths[p] = params;
+					m_busyPaths++;
+					return;
+				}
+			}
+			NS_LOG_DEBUG("All " << m_nPaths << " demodulator paths are busy " << params);
+			m_pathExhaustions++;
+			m_pathExhaustedTrace (params->packet, params->GetChannel(), params->GetSpreading());
+			SetLost (params);
+		}
+
+	void
+		LoRaGwPhy::LockPendingPaths (void)
+		{
+			// the paths only change at the start and the end of signals, so the locks
+			// can wait until then instead of having an event each. A lock due right now
+			// waits, so a signal shorter than its preamble ends before it locks.
+			while (!m_pendingLocks.empty () && m_pendingLocks.begin ()->first < Simulator::Now ())
+			{
+				Ptr<LoRaSpectrumSignalParameters> params = m_pendingLocks.begin ()->second;
+				m_pendingLocks.erase (m_pendingLocks.begin ());
+				LockPath (params);
+			}
+		}
+
+	LoRaGwPhy::ReceptionSlots::iterator
+		LoRaGwPhy::FindSlot (Ptr<LoRaSpectrumSignalParameters> params)
+		{
+			return m_slots.find (std::make_pair (GetSfClass (params), params->GetChannel()));
+		}
+
+	LoRaGwPhy::ReceptionSlot::iterator
+		LoRaGwPhy::FindReception (ReceptionSlot &slot, Ptr<LoRaSpectrumSignalParameters> params)
+		{
+			ReceptionSlot::iterator it = slot.begin();
+			while (it != slot.end() && it->params != params)
+			{
+				it++;
+			}
+			return it;
+		}
+
+	void
+		LoRaGwPhy::FreePath (Ptr<LoRaSpectrumSignalParameters> params)
+		{
+			for (uint32_t p = 0; p < m_paths.size (); p++)
+			{
+				if (m_paths[p] == params)
+				{
+					m_paths[p] = 0;
+					m_busyPaths--;
+					return;
+				}
+			}
+		}
+
+	uint32_t
+		LoRaGwPhy::GetCollisions()
+		{
+			return m_collisions;
+		}
+
+	uint32_t 
+		LoRaGwPhy::GetReceptions()
+		{
+			return m_healthyReceptions;
+		}
+
+	uint32_t 
+		LoRaGwPhy::GetReceptions(uint32_t freq)
+		{
+			std::map<uint32_t, uint32_t>::const_iterator it = m_healthyPerChannel.find (freq);
+			return it != m_healthyPerChannel.end () ? it->second : 0;
 		}
 
 	void 
 		LoRaGwPhy::EndRx (Ptr<LoRaSpectrumSignalParameters> params)
 		{
 			NS_LOG_FUNCTION(this << params);
-			//update BER
-			UpdateBer();
-			//Remove packet from list
-			std::vector<Ptr<LoRaSpectrumSignalParameters> >::iterator temp=m_params.begin();
-			for (std::vector<Ptr<LoRaSpectrumSignalParameters> >::iterator it=m_params.begin(); it!=m_params.end();it++)
+			//the BER was updated by EndOfSignal
+			//Remove packet from its slot
+			ReceptionSlots::iterator slot = FindSlot (params);
+			NS_ASSERT (slot != m_slots.end ());
+			ReceptionSlot::iterator it = FindReception (slot->second, params);
+			NS_ASSERT (it != slot->second.end());
+			Reception reception = *it;
+			*it = slot->second.back();
+			slot->second.pop_back();
+			if (slot->second.empty ())
 			{
-				if (*it==params)
-				{
-					temp = it;
-					break;
-				}
+				m_slots.erase (slot);
+			}
+			if (params->GetBer() == 0)
+			{
+				m_healthyReceptions--;
+				m_healthyPerChannel[params->GetChannel()]--;
 			}
-			m_params.erase(temp);
+			FreePath (params);
 			NS_LOG_DEBUG("params are erased" << params << GetReceptions());
+			//score the SINR timeline, collided packets are already lost
+			if (params->GetBer() < 10)
+			{
+				params->SetBer(params->GetBer() + GetBitErrors (params));
+			}
+			if (!reception.blockers.empty() && params->GetBer() < 10)
+			{
+				//the stronger signals have to be decoded first
+				m_sicWaiting.push_back (reception);
+				ResolveSic ();
+				return;
+			}
+			ReleaseBlockers (reception);
+			Deliver (params, 0);
+		}
+
+	void
+		LoRaGwPhy::EndOfSignal (Ptr<SpectrumSignalParameters> params)
+		{
+			NS_LOG_FUNCTION(this << params);
+			//update BER because noise is changing
+			UpdateBer();
+			LockPendingPaths ();
+			Ptr<LoRaSpectrumSignalParameters> sfParams = DynamicCast<LoRaSpectrumSignalParameters> (params);
+			if (sfParams != 0)
+			{
+				EndRx (sfParams);
+			}
+			// remove noise source
+			RemoveReceivingPower (params->psd);
+		}
+
+	void
+		LoRaGwPhy::Deliver (Ptr<LoRaSpectrumSignalParameters> params, uint32_t depth)
+		{
+			NS_LOG_FUNCTION(this << params << depth);
 			//decide packet error or not
 			if(params->GetBer()<5)
 			{
 				//no packet error
-				LoRaPhyHeader lh;
-				Ptr<Packet> packet = params->packet;
-				packet->RemoveHeader(lh);
-				m_ReceptionEnd( packet, params->GetBandwidth(), params->GetSpreading(), params->GetChannel(),(*params->psd)[(params->GetChannel()-868e4)/250+1]*params->GetBandwidth());
+				if (depth > 0)
+				{
+					m_sicRecoveries++;
+				}
+				if (DynamicCast<LoRaPhy> (params->txPhy) == 0)
+				{
+					//background traffic of a LoRaAggregateInterference is not forwarded
+					NS_LOG_DEBUG("background packet received");
+				}
+				else
+				{
+					LoRaPhyHeader lh;
+					Ptr<Packet> packet = params->packet;
+					packet->RemoveHeader(lh);
+					m_ReceptionEnd( packet, params->GetBandwidth(), params->GetSpreading(), params->GetChannel(),(*params->psd)[(params->GetChannel()-868e4)/250+1]*params->GetBandwidth());
+				}
 			}
 			else
 			{
 				//packet error
 				m_ReceptionError();
 			}
+			if (m_blockerReferences.find (params) != m_blockerReferences.end ())
+			{
+				//weaker signals are waiting for this one
+				m_sicOutcome[params] = params->GetBer() < 5 ? depth : -1;
+				ResolveSic ();
+			}
 		}
 
+	void
+		LoRaGwPhy::ReleaseBlockers (const Reception &reception)
+		{
+			for (std::vector<Blocker>::const_iterator b = reception.blockers.begin (); b != reception.blockers.end (); b++)
+			{
+				std::map<Ptr<LoRaSpectrumSignalParameters>, uint32_t>::iterator ref = m_blockerReferences.find (b->params);
+				NS_ASSERT (ref != m_blockerReferences.end ());
+				if (--ref->second == 0)
+				{
+					m_blockerReferences.erase (ref);
+					m_sicOutcome.erase (b->params);
+				}
+			}
+		}
 
-	void 
-		LoRaGwPhy::UpdateBer ()
+	void
+		LoRaGwPhy::ResolveSic (void)
 		{
 			NS_LOG_FUNCTION(this);
-			double timeNow = Simulator::Now().GetSeconds(); 
-			for (auto &i : m_params)
+			bool decided = true;
+			while (decided)
 			{
-				//calculate SNR
-				if (i->GetBer() < 10)
+				decided = false;
+				for (uint32_t w = 0; w < m_sicWaiting.size () && !decided; w++)
 				{
-					Ptr<SpectrumValue> noise = m_receivingPower->Copy();
-					*noise -= *i->psd; 
-					double signalPower = 0.0;
-					double noisePower = 0.0;
-					uint32_t bandwidth = i->GetBandwidth();
-					uint32_t freq = i->GetChannel();
-					for ( int k = (freq-868e4-bandwidth/200)/250+1; k<(freq-868e4+bandwidth/200)/250+1; k++){
-						signalPower += (*i->psd)[k];
-						noisePower += ((*noise)[k]+m_k*m_temperature);
-					}
-					double snr = signalPower/noisePower;
-					//getBER
-					long double berEs = m_errorModel->GetBER (snr, i->GetSpreading(), m_bandwidth);
-					double m_bitErrors = i->GetBer();
-					SetSpreadingFactor(i->GetSpreading());
-					SetBandwidth(i->GetBandwidth());
-					uint16_t bits = (timeNow - m_lastCheck)*GetBitRate(m_spreadingfactor);
-					for ( uint16_t it = 0; it<bits; it++)
+					// a reception can be decided once all of its blockers are
+					int32_t depth = 0;
+					for (std::vector<Blocker>::const_iterator b = m_sicWaiting[w].blockers.begin (); b != m_sicWaiting[w].blockers.end () && depth >= 0; b++)
 					{
-						if(m_random->GetValue()<berEs)
+						std::map<Ptr<LoRaSpectrumSignalParameters>, int32_t>::const_iterator outcome = m_sicOutcome.find (b->params);
+						if (outcome == m_sicOutcome.end ())
+						{
+							depth = -2;
+						}
+						else
 						{
-							m_bitErrors+=1;
+							depth = outcome->second < 0 ? -1 : std::max (depth, outcome->second+1);
 						}
 					}
-					if (m_bitErrors>0)
+					if (depth == -2)
+					{
+						continue;
+					}
+					Reception reception = m_sicWaiting[w];
+					m_sicWaiting.erase (m_sicWaiting.begin ()+w);
+					decided = true;
+					ReleaseBlockers (reception);
+					if (depth < 0 || (uint32_t) depth > m_sicIterations)
+					{
+						//a blocker was lost, or too many cancellations are needed
+						reception.params->SetBer(10);
+						depth = 0;
+					}
+					Deliver (reception.params, depth);
+				}
+			}
+		}
+
+
+	void 
+		LoRaGwPhy::AddSinrSegments (double timeNow)
+		{
+			NS_LOG_FUNCTION(this << timeNow);
+			for (auto &slot : m_slots)
+			{
+				for (auto &reception : slot.second)
+				{
+					Ptr<LoRaSpectrumSignalParameters> i = reception.params;
+					//calculate SNR
+					if (i->GetBer() < 10)
 					{
-						NS_LOG_DEBUG(snr << " " << signalPower << " " << noisePower << " " <<  bits << " " << GetBitRate(m_spreadingfactor) << " " << m_bitErrors << " " << berEs);
+						double signalPower = 0.0;
+						uint32_t bandwidth = i->GetBandwidth();
+						uint32_t freq = i->GetChannel();
+						double noisePower = GetNoisePower (i->psd, (freq-868e4-bandwidth/200)/250+1, (freq-868e4+bandwidth/200)/250+1, signalPower);
+						//in SIC mode, the stronger signals are decoded and cancelled first
+						double cancelled = 0.0;
+						for (std::vector<Blocker>::const_iterator b = reception.blockers.begin (); b != reception.blockers.end (); b++)
+						{
+							if (b->start.GetSeconds() <= m_lastCheck && (b->start+b->params->duration).GetSeconds() >= timeNow)
+							{
+								cancelled += m_sicEfficiency*b->power;
+							}
+						}
+						noisePower = std::max (noisePower-cancelled, noisePower*(1-m_sicEfficiency));
+						double snr = signalPower/noisePower;
+						// bit errors are drawn from the whole timeline in EndRx
+						i->AddSinrSegment (timeNow-m_lastCheck, snr);
 					}
-					//calculate numbers of biterrors	
-					i->SetBer(m_bitErrors);
 				}
 			}
 			m_lastCheck = timeNow;
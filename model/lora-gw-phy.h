@@ -31,6 +31,10 @@
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/callback.h>
+#include <ns3/traced-value.h>
+#include <ns3/traced-callback.h>
+#include <map>
+#include <vector>
 namespace ns3 {
 
 	class SpectrumChannel;
@@ -44,11 +48,41 @@ namespace ns3 {
 	 *
 	 * Physical layer implementation for base stations
 	 *
+	 * Receptions are demodulated by a pool of DemodulatorPaths (8 on an SX1301, 16 on an
+	 * SX1302) shared by the IF chains. A path locks on a reception when its preamble is
+	 * detected, after PreambleLockSymbols symbols, and is freed at the end of the reception
+	 * or as soon as it is lost. A reception that finds all paths busy is lost.
+	 *
+	 * Overlapping receptions survive each other when their power ratio exceeds the
+	 * SirMatrix threshold of their spreading factors. With the preamble CaptureModel, a
+	 * stronger signal of the same SF is only captured before the receiver locked on the first.
+	 *
+	 * With Sic, a signal that loses against a stronger one is not dropped: once the stronger
+	 * one is decoded, SicEfficiency of its power is removed from the interference and the
+	 * weaker one is decoded from what is left, up to SicIterations cancellations deep.
 	 */
 	class LoRaGwPhy : public LoRaPhy 
 	{
 
 		public:
+			/**
+			 * Tables of the signal to interference ratio a spreading factor needs to survive another one
+			 */
+			enum SirMatrix
+			{
+				SIR_ORTHOGONAL, //!< 6 dB for the same SF, different SFs do not interfere
+				SIR_GOURSAUD //!< the quasi-orthogonal SFs of Goursaud and Gorce (2015)
+			};
+
+			/**
+			 * Resolution of a collision between signals of the same SF
+			 */
+			enum CaptureModel
+			{
+				CAPTURE_POWER, //!< the signal that is stronger by the SIR threshold survives
+				CAPTURE_PREAMBLE //!< a later, stronger signal is only captured while the receiver is not locked yet on the first one
+			};
+
 			LoRaGwPhy ();
 			~LoRaGwPhy ();
 
@@ -61,8 +95,15 @@ namespace ns3 {
 			 *
 			 * \return a Ptr to the associated NetDevice instance
 			 */
-		uint32_t GetReceptions ();
-		uint32_t GetReceptions(uint32_t freq);
+		virtual uint32_t GetReceptions ();
+		virtual uint32_t GetReceptions(uint32_t freq);
+		/**
+		 * Set the channel attached to this device.
+		 * A gateway always listens, so it never unsubscribes from a LoRaSpectrumChannel.
+		 *
+		 * \param c the channel
+		 */
+		void SetChannel (Ptr<SpectrumChannel> c);
 		/**
 		 * Notify the SpectrumPhy instance of an incoming signal
 		 *
@@ -76,6 +117,14 @@ namespace ns3 {
 		 * \param params the parameters of the signals being received
 		 */
 		void EndRx (Ptr<LoRaSpectrumSignalParameters> params);
+
+		/**
+		 * Single end event of an incoming signal: update the BER, end the
+		 * reception of LoRa signals and remove the power of the signal.
+		 *
+		 * \param params the parameters of the signal that ends
+		 */
+		void EndOfSignal (Ptr<SpectrumSignalParameters> params);
 		/**
 		 * Start the transmission of the given packet.
 		 * 
@@ -94,18 +143,217 @@ namespace ns3 {
 		 */
 		uint32_t GetCollisions (void); 
 
+		/**
+		 * Restrict the channels the IF chains are tuned to. Receptions on other
+		 * channels never get a demodulator path. Without channels, all channels are demodulated.
+		 *
+		 * This is a channel filter, not an assignment of receptions to IF chains: like in
+		 * the SX1301, every tuned channel draws from the shared pool of demodulator paths
+		 * and an IF chain does not limit the receptions on its channel.
+		 *
+		 * \param channels channel of every IF chain (*100Hz)
+		 */
+		void SetIfChannels (const std::vector<uint32_t> &channels);
 
+		/**
+		 * Get the number of receptions that found all demodulator paths busy.
+		 *
+		 * \return number of receptions lost for lack of a path
+		 */
+		uint32_t GetPathExhaustions (void);
+
+		/**
+		 * Load one of the SIR matrices
+		 *
+		 * \param matrix the matrix
+		 */
+		void SetSirMatrix (SirMatrix matrix);
+		SirMatrix GetSirMatrix (void) const;
+
+		/**
+		 * Set the signal to interference ratio a spreading factor needs to survive another one
+		 *
+		 * \param wanted the spreading factor of the wanted signal (7-12)
+		 * \param interferer the spreading factor of the interfering signal (7-12)
+		 * \param sirDb the ratio in dB, -HUGE_VAL if the interferer never destroys the wanted signal
+		 */
+		void SetSirThreshold (uint8_t wanted, uint8_t interferer, double sirDb);
+
+		/**
+		 * Get the number of receptions that were only decoded after cancelling stronger ones.
+		 *
+		 * \return number of receptions recovered by SIC
+		 */
+		uint32_t GetSicRecoveries (void);
+
+		/**
+		 * TracedCallback signature for receptions that find no free demodulator path.
+		 *
+		 * \param [in] packet the packet that is lost
+		 * \param [in] channel the channel of the packet
+		 * \param [in] spreading the spreading factor of the packet
+		 */
+		typedef void (* PathExhaustedCallback) (Ptr<const Packet> packet, uint32_t channel, uint8_t spreading);
+
+
+
+		protected:
+		Callback<void, Ptr<Packet>,uint32_t, uint8_t, uint32_t,double> m_ReceptionEnd; //!<callbackfunction with extra field
 
 		private:
 		uint32_t m_collisions; //!< Collisions that are happened
-		std::vector <Ptr<LoRaSpectrumSignalParameters> > m_params; //!<parameters of all the arriving packets
-		Callback<void, Ptr<Packet>,uint32_t, uint8_t, uint32_t,double> m_ReceptionEnd; //!<callbackfunction with extra field
+		/**
+		 * A stronger reception that has to be decoded and cancelled before a weaker one can be
+		 */
+		struct Blocker
+		{
+			Ptr<LoRaSpectrumSignalParameters> params; //!< the stronger signal
+			double power; //!< power of the stronger signal in its own band
+			Time start; //!< arrival of the stronger signal
+		};
+		/**
+		 * An ongoing reception
+		 */
+		struct Reception
+		{
+			Ptr<LoRaSpectrumSignalParameters> params; //!< the signal
+			double power; //!< power of the signal in its own band
+			Time start; //!< arrival of the signal
+			std::vector<Blocker> blockers; //!< signals to cancel first in SIC mode
+		};
+		typedef std::vector <Reception> ReceptionSlot; //!< receptions with the same SF class and channel
+		typedef std::map<std::pair<uint32_t,uint32_t>, ReceptionSlot> ReceptionSlots; //!< slots by (SF class, channel)
+		ReceptionSlots m_slots; //!<parameters of all the arriving packets per (SF class, channel), without empty slots
+		uint32_t m_maxHalfBandwidth; //!< half of the widest bandwidth seen, in units of 100 Hz
+		uint32_t m_healthyReceptions; //!< receptions without bit errors
+		std::map<uint32_t, uint32_t> m_healthyPerChannel; //!< receptions without bit errors per channel
+		uint32_t m_nPaths; //!< number of demodulator paths
+		uint32_t m_lockSymbols; //!< preamble symbols before a path locks on a reception
+		std::vector<uint32_t> m_ifChannels; //!< channels of the IF chains, all channels if empty
+		std::vector<Ptr<LoRaSpectrumSignalParameters> > m_paths; //!< reception of every demodulator path, 0 if free
+		std::multimap<Time, Ptr<LoRaSpectrumSignalParameters> > m_pendingLocks; //!< receptions by the time their preamble is detected
+		TracedValue<uint32_t> m_busyPaths; //!< number of locked demodulator paths
+		uint32_t m_pathExhaustions; //!< receptions that found no free path
+		TracedCallback<Ptr<const Packet>, uint32_t, uint8_t> m_pathExhaustedTrace; //!< reception that found no free path
+		double m_sirRatio[6][6]; //!< minimal power ratio of a wanted SF (row, SF7-SF12) over an interfering SF (column) to survive
+		SirMatrix m_sirMatrix; //!< the matrix m_sirRatio was loaded from
+		bool m_interSf; //!< some spreading factors of the same bandwidth interfere
+		CaptureModel m_captureModel; //!< how a collision between the same SF is resolved
+		bool m_sic; //!< decode weaker signals after cancelling the stronger ones
+		double m_sicEfficiency; //!< fraction of the power of a decoded signal that is cancelled
+		uint32_t m_sicIterations; //!< maximal depth of a chain of cancellations
+		uint32_t m_sicRecoveries; //!< receptions decoded thanks to SIC
+		std::vector<Reception> m_sicWaiting; //!< finished receptions waiting for their blockers
+		std::map<Ptr<LoRaSpectrumSignalParameters>, uint32_t> m_blockerReferences; //!< number of receptions waiting for a signal
+		std::map<Ptr<LoRaSpectrumSignalParameters>, int32_t> m_sicOutcome; //!< cancellation depth of a decoded blocker, -1 if lost
+
+
+		/**
+		 * Add a SINR piece from the last check until the given time to all receiving transmissions
+		 *
+		 * \param timeNow the end of the piece (s)
+		 */
+		void AddSinrSegments (double timeNow);
+
+		/**
+		 * Get the class of a spreading factor and bandwidth. Only signals of the same class
+		 * (the same chirp rate) interfere with each other.
+		 *
+		 * \param params the signal
+		 * \return the class
+		 */
+		static uint32_t GetSfClass (Ptr<LoRaSpectrumSignalParameters> params);
 
+		/**
+		 * Mark a reception as lost
+		 *
+		 * \param params the reception
+		 */
+		void SetLost (Ptr<LoRaSpectrumSignalParameters> params);
+
+		/**
+		 * Lock a free demodulator path on a reception once its preamble is detected.
+		 * The reception is lost if it is not on an IF channel or all paths are busy.
+		 *
+		 * \param params the reception
+		 */
+		void LockPath (Ptr<LoRaSpectrumSignalParameters> params);
+
+		/**
+		 * Lock the paths of all receptions whose preamble was detected by now, in order.
+		 * Called before every change of the receptions, so no event per reception is needed.
+		 */
+		void LockPendingPaths (void);
+
+		/**
+		 * Free the demodulator path of a reception, if it has one
+		 *
+		 * \param params the reception
+		 */
+		void FreePath (Ptr<LoRaSpectrumSignalParameters> params);
+
+		/**
+		 * Find the slot of a reception, without creating it
+		 *
+		 * \param params the reception
+		 * \return its slot, or the end of m_slots
+		 */
+		ReceptionSlots::iterator FindSlot (Ptr<LoRaSpectrumSignalParameters> params);
+
+		/**
+		 * Find a reception in its slot
+		 *
+		 * \param slot the slot of the reception
+		 * \param params the reception
+		 * \return the position in its slot, or the end of the slot
+		 */
+		static ReceptionSlot::iterator FindReception (ReceptionSlot &slot, Ptr<LoRaSpectrumSignalParameters> params);
+
+		/**
+		 * Check if a signal survives an interferer
+		 *
+		 * \param wanted the wanted signal
+		 * \param interferer the interfering signal
+		 * \return true if the power ratio is above the SIR threshold of the pair
+		 */
+		bool Survives (const Reception &wanted, const Reception &interferer) const;
+
+		/**
+		 * Resolve the collision between an ongoing reception and a new one
+		 *
+		 * \param current the ongoing reception
+		 * \param arriving the new reception
+		 */
+		void Collide (Reception &current, Reception &arriving);
+
+		/**
+		 * Let a weaker signal wait for the decoding of a stronger one instead of losing it
+		 *
+		 * \param victim the weaker signal
+		 * \param blocker the stronger signal
+		 * \return true if SIC can help
+		 */
+		bool Block (Reception &victim, const Reception &blocker);
+
+		/**
+		 * Report the end of a reception to the device
+		 *
+		 * \param params the finished reception
+		 * \param depth number of cancellations it needed
+		 */
+		void Deliver (Ptr<LoRaSpectrumSignalParameters> params, uint32_t depth);
+
+		/**
+		 * Drop the references of a reception that no longer waits for its blockers
+		 *
+		 * \param reception the reception
+		 */
+		void ReleaseBlockers (const Reception &reception);
 
 		/**
-		 * Update the BER for all receiving transmissions based on latest information 
+		 * Decide the receptions whose blockers are all decoded or lost
 		 */
-		void UpdateBer (void);
+		void ResolveSic (void);
 	};
 } // namespace ns3
 
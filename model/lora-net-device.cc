@@ -19,7 +19,6 @@
  */
 #include "ns3/lora-phy.h"
 #include "ns3/log.h"
-#include "ns3/queue.h"
 #include "ns3/simulator.h"
 #include "ns3/enum.h"
 #include "ns3/boolean.h"
@@ -32,10 +31,19 @@
 #include <ns3/link-check-req.h>
 #include "lora-net-device.h"
 #include <ns3/random-variable-stream.h>
+#include <algorithm>
 namespace ns3 {
 
 	NS_LOG_COMPONENT_DEFINE ("LoRaNetDevice");
 
+	// ETSI EN 300 220 duty cycle of every sub-band, indexed by LoRaNetDevice::SubBand
+	static const double subBandDutyCycle [LoRaNetDevice::SUB_BANDS] = {0.01,0.01,0.001,0.1,0.01,1.0};
+
+	// the data rate and power tables are the same for every device
+	const uint8_t LoRaNetDevice::spreading [16] = {12,11,10,9,8,7,7,1,1,1,1,1,1,1,1,1};
+	const double LoRaNetDevice::power [16] = {0,0.025,0.0126,0.0063,0.0031,0.0016,0,0,0,0,0,0,0,0,0,0};
+	const uint32_t LoRaNetDevice::bandwidth [16] = {125000,125000,125000,125000,125000,125000,250000,125000,125000,125000,125000,125000,125000,125000,125000,125000};
+
 	std::ostream& operator<< (std::ostream& os, LoRaNetDevice::State state)
 	{
 		switch (state)
@@ -89,6 +97,23 @@ namespace ns3 {
   					BooleanValue(false),
   					MakeBooleanAccessor (&LoRaNetDevice::m_reliable),
             MakeBooleanChecker ())
+  			.AddAttribute ("LazyReceiveWindows",
+  					"Only open a receive window if a gateway scheduled a downlink for this device in it. "
+  					"The skipped windows are still charged to the energy model.",
+  					BooleanValue(false),
+  					MakeBooleanAccessor (&LoRaNetDevice::m_lazyReceiveWindows),
+            MakeBooleanChecker ())
+				.AddAttribute ("MaxPackets", "The maximum number of packets in the uplink queue",
+						UintegerValue (100),
+						MakeUintegerAccessor (&LoRaNetDevice::SetQueueMaxPackets,
+							&LoRaNetDevice::GetQueueMaxPackets),
+						MakeUintegerChecker<uint32_t> ())
+				.AddAttribute ("DropPolicy", "The packet dropped when the uplink queue is full",
+						EnumValue (LoRaUplinkQueue::DROP_TAIL),
+						MakeEnumAccessor (&LoRaNetDevice::SetQueueDropPolicy,
+							&LoRaNetDevice::GetQueueDropPolicy),
+						MakeEnumChecker (LoRaUplinkQueue::DROP_TAIL, "DropTail",
+							LoRaUplinkQueue::DROP_OLDEST, "DropOldest"))
 				.AddAttribute ("Mtu", "The Maximum Transmission Unit",
 						UintegerValue (255),
 						MakeUintegerAccessor (&LoRaNetDevice::SetMtu,
@@ -132,10 +157,19 @@ namespace ns3 {
 	{
 		NS_LOG_FUNCTION (this);
 		m_random=CreateObject<UniformRandomVariable> ();
+		m_plan = LoRaChannelPlan::GetDefault ();
 		m_seqNum =0;
 		m_currentPkt = 0;
-		m_dutyCycle = 7;
-		m_waitingFactor = 99;//(1.0-pow(2.0,-(double)m_dutyCycle))/pow(2.0,-(double)m_dutyCycle);
+		// only the sub-band duty cycles apply until a DutyCycleReq arrives
+		m_dutyCycle = 0;
+		m_waitingFactor = 0;
+		for (uint8_t band = 0; band < SUB_BANDS; band++)
+		{
+			m_subBandFree[band] = Seconds (0);
+			m_subBandAirtime[band] = Seconds (0);
+		}
+		m_aggregatedFree = Seconds (0);
+		m_lazyReceiveWindows = false;
 		m_delay = 1;
 		retransmissionCount = 0;
 		m_powerIndex = 1;
@@ -160,12 +194,13 @@ namespace ns3 {
 		LoRaNetDevice::DoDispose ()
 		{
 			NS_LOG_FUNCTION (this);
-			m_queue = 0;
+			m_queue.Clear ();
 			m_node = 0;
 			m_channel = 0;
 			m_currentPkt = 0;
 			m_phy = 0;
 			m_random = 0;
+			m_plan = 0;
 			m_phyMacTxStartCallback = MakeNullCallback< bool, Ptr<Packet> > ();
 			m_rxCallback = MakeNullCallback <bool, Ptr<NetDevice>, Ptr<const Packet>, uint16_t, const Address& > ();
 			m_promiscRxCallback = MakeNullCallback <bool, Ptr<NetDevice>,Ptr<const Packet>, uint16_t, const Address&, const Address&, PacketType > ();
@@ -229,10 +264,40 @@ uint32_t
 
 
 	void
-		LoRaNetDevice::SetQueue (Ptr<Queue<QueueItem>> q)
+		LoRaNetDevice::SetQueueMaxPackets (uint32_t maxPackets)
 		{
-			NS_LOG_FUNCTION (q);
-			m_queue = q;
+			NS_LOG_FUNCTION (maxPackets);
+			m_queue.SetMaxPackets (maxPackets);
+		}
+
+	uint32_t
+		LoRaNetDevice::GetQueueMaxPackets (void) const
+		{
+			return m_queue.GetMaxPackets ();
+		}
+
+	void
+		LoRaNetDevice::SetQueueDropPolicy (LoRaUplinkQueue::DropPolicy policy)
+		{
+			NS_LOG_FUNCTION (policy);
+			m_queue.SetDropPolicy (policy);
+		}
+
+	LoRaUplinkQueue::DropPolicy
+		LoRaNetDevice::GetQueueDropPolicy (void) const
+		{
+			return m_queue.GetDropPolicy ();
+		}
+
+	bool
+		LoRaNetDevice::Enqueue (Ptr<Packet> packet)
+		{
+			Ptr<Packet> dropped = m_queue.Enqueue (packet);
+			if (dropped != 0)
+			{
+				m_macTxDropTrace (dropped);
+			}
+			return dropped != packet;
 		}
 
 
@@ -444,22 +509,13 @@ uint32_t
 			{
 				Simulator::Remove(m_event);
 				NS_LOG_LOGIC ("enqueueing new packet");
-				if (m_queue->Enqueue (Create<QueueItem> (packet)) == false)
-				{
-					m_macTxDropTrace (packet);
-					sendOk = false;
-				}
+				sendOk = Enqueue (packet);
 				Simulator::ScheduleNow(&LoRaNetDevice::TryAgain,this);
 			}
 			else
 			{
 				NS_LOG_LOGIC ("deferring TX, enqueueing new packet");
-				NS_ASSERT (m_queue);
-				if (m_queue->Enqueue (Create<QueueItem> (packet)) == false)
-				{
-					m_macTxDropTrace (packet);
-					sendOk = false;
-				}
+				sendOk = Enqueue (packet);
 			}
 			return sendOk;
 
@@ -475,16 +531,59 @@ uint32_t
 	uint8_t
 		LoRaNetDevice::GetFreeChannel()
 		{
-	  	int chan = m_random->GetInteger(0,2);
-			uint8_t it = 0;
-			while(it < 16)
+			Time now = Simulator::Now ();
+			if (m_aggregatedFree > now)
+				return 127;
+			// one pass over the enabled channels, then a random one of those that may transmit
+			uint8_t candidates [16];
+			uint8_t nCandidates = 0;
+			for (uint8_t i = 0; i < 16; i++)
+			{
+				if (m_plan->available[i] && m_subBandFree[GetSubBand (m_plan->frequencies[i])] <= now)
+					candidates[nCandidates++] = i;
+			}
+			if (nCandidates == 0)
+				return 127;
+			return candidates[m_random->GetInteger (0, nCandidates-1)];
+		}
+
+	LoRaNetDevice::SubBand
+		LoRaNetDevice::GetSubBand (uint32_t frequency)
+		{
+			if (frequency >= 8630000 && frequency < 8680000)
+				return SUB_BAND_G;
+			if (frequency >= 8680000 && frequency <= 8686000)
+				return SUB_BAND_G1;
+			if (frequency >= 8687000 && frequency <= 8692000)
+				return SUB_BAND_G2;
+			if (frequency >= 8694000 && frequency <= 8696500)
+				return SUB_BAND_G3;
+			if (frequency >= 8697000 && frequency <= 8700000)
+				return SUB_BAND_G4;
+			return SUB_BAND_NONE;
+		}
+
+	double
+		LoRaNetDevice::GetSubBandDutyCycle (SubBand band)
+		{
+			NS_ASSERT (band < SUB_BANDS);
+			if (Simulator::Now ().IsZero ())
+				return 0;
+			return m_subBandAirtime[band].GetSeconds ()/Simulator::Now ().GetSeconds ();
+		}
+
+	Time
+		LoRaNetDevice::GetNextTransmissionTime ()
+		{
+			Time next = Time::Max ();
+			for (uint8_t i = 0; i < 16; i++)
 			{
-				if (channelAvailable[chan%16])
-					return chan%16;
-				chan+=7;
-				it++;
+				if (m_plan->available[i])
+					next = std::min (next, m_subBandFree[GetSubBand (m_plan->frequencies[i])]);
 			}
-		return 127;
+			if (next == Time::Max ())
+				return next;
+			return std::max (next, m_aggregatedFree);
 		}
 
 	void
@@ -502,12 +601,12 @@ uint32_t
 			{
 				m_channelIndex = channel;
 				// Set parameters of phy device
-				if (StartTransmission (m_currentPkt->Copy(), frequencies[channel], datarate[channel], m_powerIndex))
+				if (StartTransmission (m_currentPkt->Copy(), m_plan->frequencies[channel], datarate[channel], m_powerIndex))
 				{
 					retransmissionCount++;
 					m_state = TX;
 					m_macTxTrace(m_currentPkt);
-					LastSend [channel] = Simulator::Now().GetSeconds();
+					m_lastSend = Simulator::Now();
 				}
 			}
 			else
@@ -540,13 +639,6 @@ uint32_t
 			}
 		}
 
-	void
-		LoRaNetDevice::FreeChannel (uint8_t channelIndex)
-		{
-			NS_LOG_FUNCTION ((uint32_t) channelIndex);
-			channelAvailable[channelIndex] = true;
-		}
-
 	bool
 		LoRaNetDevice::SetMaxPower (uint8_t maxPower)
 		{
@@ -567,7 +659,7 @@ uint32_t
 			bool change = false;
 			for (uint8_t i=0; i<16; i++)
 			{
-				if (maxSetting <= maxDatarate[i])
+				if (maxSetting <= m_plan->maxDatarate[i])
 				{
 					change = true;
 					datarate[i] = maxSetting;
@@ -583,7 +675,7 @@ uint32_t
 			NS_LOG_FUNCTION((uint32_t)maxSetting << (uint32_t) index);
 			NS_ASSERT (maxSetting < 0x0F);
 			datarate[index] = maxSetting;
-			maxDatarate[index] = maxSetting;
+			GetWritablePlan ()->maxDatarate[index] = maxSetting;
 			return true;
 		}
 	
@@ -592,7 +684,7 @@ uint32_t
 		{
 			NS_LOG_FUNCTION((uint32_t)minSetting << (uint32_t) index);
 			NS_ASSERT (minSetting < 0x0F);
-			minDatarate[index] = minSetting;
+			GetWritablePlan ()->minDatarate[index] = minSetting;
 			return true;
 		}
 	bool
@@ -600,7 +692,7 @@ uint32_t
 		{
 			for (uint8_t i=0; i<16; i++)
 			{
-				minDatarate[i] = minSetting;
+				GetWritablePlan ()->minDatarate[i] = minSetting;
 			}
 			return true;
 		}
@@ -615,8 +707,8 @@ uint32_t
 		LoRaNetDevice::AddChannel (uint8_t index, uint32_t freq)
 		{
 			NS_LOG_FUNCTION (index << freq);
-			frequencies[index] = freq;
-			channelAvailable [index] = true;
+			GetWritablePlan ()->frequencies[index] = freq;
+			GetWritablePlan ()->available[index] = true;
 			return true;
 		}
 	
@@ -624,8 +716,7 @@ uint32_t
 		LoRaNetDevice::RemoveChannel (uint8_t index)
 		{
 			NS_LOG_FUNCTION (index);
-			channelAvailable [index] = false;
-			m_freeChannel.Cancel();
+			GetWritablePlan ()->available[index] = false;
 		}
 
 	void 
@@ -670,14 +761,165 @@ uint32_t
 		{
 			NS_LOG_FUNCTION (this);
 			m_state = RX1_PENDING;
-			NS_ASSERT (m_queue);
-			channelAvailable [m_channelIndex] = false;
 			NS_LOG_DEBUG(m_channelIndex << (uint32_t)spreading[m_channelIndex]);
-			double timeNow = Simulator::Now().GetSeconds();
-			m_freeChannel = Simulator::Schedule(Seconds((timeNow-LastSend[m_channelIndex])*m_waitingFactor),&LoRaNetDevice::FreeChannel,this,m_channelIndex);
-			m_event = Simulator::Schedule(Seconds(m_delay-0.01),&LoRaNetDevice::PrepareReception, this, bandwidth[datarate[m_channelIndex]], frequencies[m_channelIndex],spreading[datarate[m_channelIndex]]);
+			// the ledger only remembers when the sub-band may be used again, GetFreeChannel checks it at send time
+			double airtime = (Simulator::Now()-m_lastSend).GetSeconds();
+			SubBand band = GetSubBand (m_plan->frequencies[m_channelIndex]);
+			m_subBandAirtime[band] += Seconds (airtime);
+			m_subBandFree[band] = std::max (m_subBandFree[band], Simulator::Now()+Seconds (airtime*(1.0/subBandDutyCycle[band]-1)));
+			m_aggregatedFree = Simulator::Now()+Seconds (airtime*m_waitingFactor);
+			if (m_lazyReceiveWindows)
+			{
+				// a single event per window decides whether it has to be opened at all
+				m_lastTxEnd = Simulator::Now ();
+				m_event = Simulator::Schedule(Seconds(m_delay-0.01),&LoRaNetDevice::LazyReception, this, true);
+				return;
+			}
+			m_event = Simulator::Schedule(Seconds(m_delay-0.01),&LoRaNetDevice::PrepareReception, this, bandwidth[datarate[m_channelIndex]], m_plan->frequencies[m_channelIndex],spreading[datarate[m_channelIndex]]);
 			m_event2 = Simulator::Schedule(Seconds(m_delay+0.99),&LoRaNetDevice::PrepareReception, this, bandwidth[m_rx2Datarate], m_rx2Freq,spreading[m_rx2Datarate]);
 		}
+
+	void
+		LoRaNetDevice::LazyReception (bool first)
+		{
+			NS_LOG_FUNCTION (this << first);
+			if (first)
+			{
+				// RX2 follows one second after RX1, whether RX1 is opened or not
+				if (HasDownlink (m_lastTxEnd, Simulator::Now ()+Seconds (0.03)))
+				{
+					m_event2 = Simulator::Schedule(Seconds(1),&LoRaNetDevice::PrepareReception, this, bandwidth[m_rx2Datarate], m_rx2Freq,spreading[m_rx2Datarate]);
+					PrepareReception (bandwidth[datarate[m_channelIndex]], m_plan->frequencies[m_channelIndex],spreading[datarate[m_channelIndex]]);
+					return;
+				}
+				m_phy->SkipReception (Seconds (0.03));
+				m_state = RX2_PENDING;
+				m_event2 = Simulator::Schedule(Seconds(1),&LoRaNetDevice::LazyReception, this, false);
+				return;
+			}
+			if (HasDownlink (m_lastTxEnd, Simulator::Now ()+Seconds (0.03)))
+			{
+				PrepareReception (bandwidth[m_rx2Datarate], m_rx2Freq,spreading[m_rx2Datarate]);
+				return;
+			}
+			// nothing can arrive in RX2 either: continue as if it timed out
+			m_phy->SkipReception (Seconds (0.03));
+			this->DoCheckReception2 ();
+		}
+
+	std::multimap<Mac32Address, Time> &
+		LoRaNetDevice::GetDownlinks (void)
+		{
+			static std::multimap<Mac32Address, Time> downlinks;
+			return downlinks;
+		}
+
+	void
+		LoRaNetDevice::NotifyDownlink (Mac32Address address, Time start)
+		{
+			NS_LOG_FUNCTION (address << start);
+			// the registry outlives the devices: empty it with the simulator
+			static bool clearScheduled = false;
+			if (!clearScheduled)
+			{
+				clearScheduled = true;
+				Simulator::ScheduleDestroy (&LoRaNetDevice::ClearDownlinks, &clearScheduled);
+			}
+			std::multimap<Mac32Address, Time> &downlinks = GetDownlinks ();
+			// HasDownlink only prunes for devices with lazy windows: sweep whenever the registry doubled
+			static std::size_t sweptSize = 0;
+			if (downlinks.empty ())
+				sweptSize = 0;
+			if (downlinks.size () >= std::max<std::size_t> (2*sweptSize, 64))
+			{
+				Time oldest = Simulator::Now ()-Seconds (MAX_RX1_DELAY+2);
+				for (std::multimap<Mac32Address, Time>::iterator it = downlinks.begin (); it != downlinks.end ();)
+				{
+					if (it->second < oldest)
+						it = downlinks.erase (it);
+					else
+						it++;
+				}
+				sweptSize = downlinks.size ();
+			}
+			downlinks.insert (std::make_pair (address, start));
+		}
+
+	uint32_t
+		LoRaNetDevice::GetNAnnouncedDownlinks (void)
+		{
+			return GetDownlinks ().size ();
+		}
+
+	void
+		LoRaNetDevice::ClearDownlinks (bool *clearScheduled)
+		{
+			GetDownlinks ().clear ();
+			*clearScheduled = false;
+		}
+
+	Ptr<const LoRaChannelPlan>
+		LoRaNetDevice::GetChannelPlan (void) const
+		{
+			return m_plan;
+		}
+
+	void
+		LoRaNetDevice::SetChannelPlan (Ptr<LoRaChannelPlan> plan)
+		{
+			NS_LOG_FUNCTION (this << plan);
+			m_plan = plan;
+		}
+
+	Ptr<LoRaChannelPlan>
+		LoRaNetDevice::GetWritablePlan (void)
+		{
+			// copy on write: the plan may be shared with other devices
+			if (m_plan->GetReferenceCount () > 1)
+			{
+				m_plan = m_plan->Copy ();
+			}
+			return m_plan;
+		}
+
+	void
+		LoRaNetDevice::SetRandomVariable (Ptr<UniformRandomVariable> random)
+		{
+			NS_LOG_FUNCTION (this << random);
+			m_random = random;
+		}
+
+	bool
+		LoRaNetDevice::HasDownlink (Time since, Time close)
+		{
+			std::multimap<Mac32Address, Time> &downlinks = GetDownlinks ();
+			Mac32Address addresses [2] = {m_address, Mac32Address::GetBroadcast ()};
+			bool found = false;
+			for (uint8_t i = 0; i < 2; i++)
+			{
+				std::multimap<Mac32Address, Time>::iterator it = downlinks.lower_bound (addresses[i]);
+				while (it != downlinks.end () && it->first == addresses[i])
+				{
+					if (it->second < since)
+					{
+						// this downlink was announced before the last uplink. A broadcast is kept
+						// for the other devices until no receive window can reach back to it.
+						if (i == 0 || it->second < Simulator::Now ()-Seconds (MAX_RX1_DELAY+2))
+						{
+							it = downlinks.erase (it);
+						}
+						else
+						{
+							it++;
+						}
+						continue;
+					}
+					found = found || it->second <= close;
+					it++;
+				}
+			}
+			return found;
+		}
 	
 	void
 		LoRaNetDevice::DoPrepareReception (uint32_t bandwidthSetting, uint32_t frequency, uint32_t spreadingfactor)
@@ -763,13 +1005,12 @@ uint32_t
 				// Get new message from the queue
 				if(m_currentPkt==0 && GetFreeChannel()!=127)
 				{
-					NS_LOG_LOGIC("Checking new transmission" << m_queue->IsEmpty());
-					if (m_queue->IsEmpty () == false)
+					NS_LOG_LOGIC("Checking new transmission" << m_queue.IsEmpty());
+					if (m_queue.IsEmpty () == false)
 					{
 						startTimePacket = Simulator::Now();
-						Ptr<QueueItem> item = m_queue->Dequeue ();
-						NS_ASSERT(item);
-						m_currentPkt = item->GetPacket ();
+						m_currentPkt = m_queue.Dequeue ();
+						NS_ASSERT(m_currentPkt);
 						LoRaMacHeader header2;
 						m_currentPkt->RemoveHeader(header2);
 						header2.SetFrmCounter(m_seqNum);
@@ -795,7 +1036,7 @@ uint32_t
 				else if(confirmed && GetFreeChannel()!=127)
 				{
 					for (uint8_t i = 0; i<16;i++){
-						if(datarate[i]>minDatarate[i] && (retransmissionCount == 3 || retransmissionCount == 5 || retransmissionCount == 7))
+						if(datarate[i]>m_plan->minDatarate[i] && (retransmissionCount == 3 || retransmissionCount == 5 || retransmissionCount == 7))
 						{
 							datarate[i]--;
 						}
@@ -803,9 +1044,15 @@ uint32_t
 					m_state = TIMEOUT;
 					m_event = Simulator::Schedule(Seconds(1+m_random->GetInteger(0,1))+MilliSeconds(m_random->GetInteger(0,999))+MicroSeconds(m_random->GetInteger(0,999))+NanoSeconds(m_random->GetInteger(0,999)),&LoRaNetDevice::StartTransmissionNoArgs, this);
 				}
-				// In case there is no free channel, delay the decision to a future time.
+				// In case there is no free channel, delay the decision until a sub-band is free again.
 				else
-					m_event = Simulator::Schedule(Seconds(1),&LoRaNetDevice::TryAgain,this);
+				{
+					Time next = GetNextTransmissionTime ();
+					Time wait = Seconds (1);
+					if (next != Time::Max ())
+						wait = std::max (wait, next-Simulator::Now ());
+					m_event = Simulator::Schedule(wait,&LoRaNetDevice::TryAgain,this);
+				}
 			}
 		}
 
@@ -826,7 +1073,7 @@ uint32_t
 				if (m_ackCnt > ADR_ACK_LIMIT)
 				{
 					for (uint8_t i = 0; i<16;i++){
-						if(datarate[i]>minDatarate[i])
+						if(datarate[i]>m_plan->minDatarate[i])
 						{
 							datarate[i]--;
 						}
@@ -858,7 +1105,7 @@ uint32_t
 				if (m_ackCnt > ADR_ACK_LIMIT)
 				{
 					for (uint8_t i = 0; i<16;i++){
-						if(datarate[i]>minDatarate[i])
+						if(datarate[i]>m_plan->minDatarate[i])
 						{
 							datarate[i]--;
 						}
@@ -955,13 +1202,12 @@ uint32_t
 		LoRaNetDevice::SetChannelMask (uint16_t channelMask)
 		{
 			NS_LOG_DEBUG(channelMask);
-			m_freeChannel.Cancel();
 			uint8_t it = 0;
 			for(uint16_t i = 0; i<16; i++)
 			{
 				if ((channelMask >> (15-i))&0x01)
 				{
-					if (frequencies[i]!=0)
+					if (m_plan->frequencies[i]!=0)
 					{
 						it++;
 					}
@@ -973,15 +1219,16 @@ uint32_t
 				{
 					if ((channelMask >> (15-i))&0x01)
 					{
-						if (frequencies[i]!=0)
+						if (m_plan->frequencies[i]!=0)
 						{
-							channelAvailable [i] = true;
+							if (!m_plan->available[i])
+								GetWritablePlan ()->available[i] = true;
 						}
 						else
 							return false;
 					}
-					else
-						channelAvailable[i] = false;
+					else if (m_plan->available[i])
+						GetWritablePlan ()->available[i] = false;
 				}
 				return true;
 			}
@@ -1003,6 +1250,7 @@ uint32_t
 			NS_LOG_FUNCTION (this << dutyCycle);
 			m_dutyCycle = dutyCycle;
 			m_waitingFactor = pow(2.0,(double)m_dutyCycle)-1;
+			NS_LOG_DEBUG ("aggregated duty cycle " << 1.0/(m_waitingFactor+1));
 		}
 
 bool LoRaNetDevice::SetRx2Settings(uint8_t datarate, uint32_t freq)
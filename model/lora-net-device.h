@@ -30,11 +30,13 @@
 #include <ns3/traced-callback.h>
 #include <ns3/nstime.h>
 #include <ns3/ptr.h>
-#include <ns3/queue-item.h>
 #include <ns3/mac32-address.h>
 #include <ns3/generic-phy.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/event-id.h>
+#include "lora-channel-plan.h"
+#include "lora-uplink-queue.h"
+#include <map>
 
 namespace ns3 {
 
@@ -44,7 +46,6 @@ class Channel;
 class SpectrumErrorModel;
 class LoRaMacHeader;
 class LoRaMacCommand;
-template <typename Item> class Queue;
 
 
 /**
@@ -67,6 +68,20 @@ public:
     IDLE, TIMEOUT, TX, RX, RETRANSMISSION, RX1_PENDING, RX2_PENDING, BEACON
   };
 
+	/**
+		* The ETSI EN 300 220 sub-bands of the 868 MHz band, each with its own duty cycle
+		*/
+  enum SubBand
+  {
+    SUB_BAND_G, //!< 863.0-868.0 MHz, 1%
+    SUB_BAND_G1, //!< 868.0-868.6 MHz, 1%
+    SUB_BAND_G2, //!< 868.7-869.2 MHz, 0.1%
+    SUB_BAND_G3, //!< 869.4-869.65 MHz, 10%
+    SUB_BAND_G4, //!< 869.7-870.0 MHz, 1%
+    SUB_BAND_NONE, //!< outside the regulated sub-bands
+    SUB_BANDS
+  };
+
 	/**
 		* See also in higher classes
 		*/
@@ -77,11 +92,24 @@ public:
 
 
   /**
-   * set the queue which is going to be used by this device
-   *
-   * \param queue the wanted queue structure
+   * \param maxPackets the maximum number of packets in the uplink queue
    */
-  virtual void SetQueue (Ptr<Queue<QueueItem>> queue);
+  void SetQueueMaxPackets (uint32_t maxPackets);
+
+  /**
+   * \return the maximum number of packets in the uplink queue
+   */
+  uint32_t GetQueueMaxPackets (void) const;
+
+  /**
+   * \param policy the packet dropped when the uplink queue is full
+   */
+  void SetQueueDropPolicy (LoRaUplinkQueue::DropPolicy policy);
+
+  /**
+   * \return the packet dropped when the uplink queue is full
+   */
+  LoRaUplinkQueue::DropPolicy GetQueueDropPolicy (void) const;
 
 
   /**
@@ -294,7 +322,9 @@ public:
 	void TryAgain();
 
 	/**
-		* Set the duty cycle
+		* Set the aggregated duty cycle of all sub-bands (DutyCycleReq)
+		*
+		* \param dutycycle the aggregated duty cycle is 1/2^dutycycle, 0 for no limit
 		*/
 	void SetDutyCycle (uint8_t dutycycle);
 
@@ -303,6 +333,67 @@ public:
 		*/
 	uint8_t GetDutyCycle ();
 
+	/**
+		* Get the sub-band of a frequency
+		*
+		* \param frequency the frequency (*100Hz)
+		* \return the sub-band
+		*/
+	static SubBand GetSubBand (uint32_t frequency);
+
+	/**
+		* Get the fraction of time this device transmitted in a sub-band so far
+		*
+		* \param band the sub-band
+		* \return the measured duty cycle
+		*/
+	double GetSubBandDutyCycle (SubBand band);
+
+	/**
+		* Get the earliest time at which an enabled channel may be used
+		*
+		* \return the time, Time::Max if no channel is enabled
+		*/
+	Time GetNextTransmissionTime ();
+
+	/**
+		* Announce a downlink, so that devices with lazy receive windows open their windows.
+		* Gateways call this when the network hands them a downlink.
+		*
+		* \param address the destination of the downlink
+		* \param start the earliest time the transmission can start
+		*/
+	static void NotifyDownlink (Mac32Address address, Time start);
+
+	/**
+		* Get the number of downlink announcements kept for the receive windows.
+		* Announcements no receive window can reach any more are removed.
+		*
+		* \return the number of announcements
+		*/
+	static uint32_t GetNAnnouncedDownlinks (void);
+
+	/**
+		* Get the channel plan of the device
+		*
+		* \return the plan, do not change it
+		*/
+	Ptr<const LoRaChannelPlan> GetChannelPlan (void) const;
+
+	/**
+		* Share a channel plan with other devices, the device copies it before it changes it
+		*
+		* \param plan the plan
+		*/
+	void SetChannelPlan (Ptr<LoRaChannelPlan> plan);
+
+	/**
+		* Replace the random generator of the MAC, for example by one shared by many devices
+		*
+		* \param random the random generator
+		*/
+	void SetRandomVariable (Ptr<UniformRandomVariable> random);
+
 	/**
 		* SetRx2Settings sets the settings for the second receive slot
 		* 
@@ -357,13 +448,15 @@ public:
 
 protected:
 
-  Ptr<Queue<QueueItem>> m_queue; //!< queue for packets to send
+  LoRaUplinkQueue m_queue; //!< queue for packets to send
   Ptr<Node>    m_node; //!< node of this netdevice
   Ptr<Channel> m_channel; //!< channel that is used
   Mac32Address m_address; //!< address of this device
 
   Ptr<UniformRandomVariable> m_random; //!< random generator
 	bool m_reliable; //!< send relaible message
+	bool m_lazyReceiveWindows; //!< only open the receive windows a downlink was announced for
+	Time m_lastTxEnd; //!< end of the last uplink
   uint32_t m_ifIndex; //!< indexnumber of the interface
   uint32_t m_mtu; //!< maximal amount of bytes to transmit
 	uint8_t m_nbRep; //!< amount of repetitions for 1 packet in unacknowledged data.
@@ -371,18 +464,20 @@ protected:
   bool m_linkUp; //!< tells if the link is up
   State m_state; //!< state of the transceiver
   uint16_t m_channelIndex; //!< index to transmit on 
-  bool channelAvailable [16] = {true,true,true,false,false,false,false,false,false,false,false,false,false,false,false,false}; //!< list of booleans if channel is available
-  double LastSend [16]; //!< time in seconds with the last transmission;
+  Ptr<LoRaChannelPlan> m_plan; //!< channels and data rate limits, shared with other devices until changed
+  Time m_lastSend; //!< start of the last transmission
+  Time m_subBandFree [SUB_BANDS]; //!< earliest time a transmission is allowed in every sub-band
+  Time m_subBandAirtime [SUB_BANDS]; //!< time on air in every sub-band
+  Time m_aggregatedFree; //!< earliest time a transmission is allowed by the aggregated duty cycle
   Ptr<Packet> m_currentPkt; //!< packet that is current being transmitted
   EventId m_event; //
-  EventId m_freeChannel; //
   EventId m_event2; //
   uint8_t m_delay; //!< delay to wait for acknowledgement
   Ptr<LoRaPhy> m_phy; //!< physical layer of this device
   uint16_t m_seqNum; //!< current packet number
   uint8_t retransmissionCount; //!< number of retransmission of the current packet
-  uint8_t m_dutyCycle; //!< maximal allowed dutycycle
-  double m_waitingFactor; //!< factor that should be waited after the transmission of a packet (to speed up calculations)
+  uint8_t m_dutyCycle; //!< maximal allowed aggregated dutycycle (1/2^m_dutyCycle)
+  double m_waitingFactor; //!< off time after a transmission relative to its airtime, for the aggregated duty cycle
   Time startTimePacket; //!< time that device tried to send a packet for the first time
   double averageTime; //!< average time to get an acknowledgement when starting to send a packet
   double avgRetransmissionCount; //!< average retransmission count
@@ -394,14 +489,12 @@ protected:
 	uint8_t m_rx1Offset; //!< Settings of the second reception
 	bool m_reset; //!< reset to highest data rate after each message from the base station
 	uint8_t m_ackCnt; //!< Amount of messages without an ACK
-	uint8_t ADR_ACK_LIMIT = 64; //!< The limit when we have to have received a message from the base station.
-	uint8_t spreading [16] = {12,11,10,9,8,7,7,1,1,1,1,1,1,1,1,1}; //!< list of spreadingfactors following the standard
-  uint32_t frequencies [16] = {8681000,8683000,8685000,8681000,8683000,8685000,0,0,0,0,0,0,0,0,0,0}; //!< list of frequencies 
-  uint16_t maxDatarate [16] = {5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5}; //!< min datarate to use on each channel
-  uint16_t minDatarate [16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}; //!< max datarate to use on each channel
+	static const uint8_t ADR_ACK_LIMIT = 64; //!< The limit when we have to have received a message from the base station.
+	static const uint8_t MAX_RX1_DELAY = 15; //!< The longest delay (s) between an uplink and RX1 in LoRaWAN.
+	static const uint8_t spreading [16]; //!< list of spreadingfactors following the standard
   uint16_t datarate [16] = {5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5}; //!< datarate to use on each channel
-  double power [16] = {0,0.025,0.0126,0.0063,0.0031,0.0016,0,0,0,0,0,0,0,0,0,0}; //!< list of powers following the standard
-  uint32_t bandwidth [16] = {125000,125000,125000,125000,125000,125000,250000,125000,125000,125000,125000,125000,125000,125000,125000,125000};//!<list of bandwidths
+  static const double power [16]; //!< list of powers following the standard
+  static const uint32_t bandwidth [16]; //!<list of bandwidths
 	std::list<Ptr<LoRaMacCommand>> m_answers; //!< List of answers to transmit to the other side
 	
   /**
@@ -416,18 +509,11 @@ protected:
 	virtual void DoTryAgain();
   
   /**
-   * This method searches a channel that is available for transmission.
+   * This method picks one of the enabled channels whose sub-band allows a transmission now.
 	 *
-	 * \return the index of the channel that can be used for the next transmission
+	 * \return the index of the channel that can be used for the next transmission, 127 if there is none
    */
 	uint8_t GetFreeChannel ();
-  
-  /**
-   *  The backoff period for the given channel is over. It can be used again.
-	 *  
-	 *  \params channelIndex the index of the channel that can be used again.
-   */
-	void FreeChannel (uint8_t channelIndex);
 
 	void PrepareReception (uint32_t bandwidth, uint32_t frequency, uint32_t spreading);
 	virtual void DoPrepareReception (uint32_t bandwidth, uint32_t frequency, uint32_t spreading);
@@ -453,6 +539,47 @@ protected:
 	 * This is the actual implementation.
    */
   virtual void DoCheckReception2 ();
+
+  /**
+   * Decide at the start of a receive window whether it has to be opened, see LazyReceiveWindows.
+   *
+   * \param first true for RX1, false for RX2
+   */
+  void LazyReception (bool first);
+
+  /**
+   * \param since end of the last uplink, older announcements are dropped
+   * \param close end of the receive window
+   * \return true if a downlink for this device or for all devices was announced that may start before the window closes
+   */
+  bool HasDownlink (Time since, Time close);
+
+  /**
+   * Get the channel plan to change it, after copying it if other devices share it
+   *
+   * \return the plan of this device only
+   */
+  Ptr<LoRaChannelPlan> GetWritablePlan (void);
+
+  /**
+   * Add a packet to the uplink queue, MacTxDrop reports the packet the queue drops
+   *
+   * \param packet the packet
+   * \return false if the packet itself was dropped
+   */
+  bool Enqueue (Ptr<Packet> packet);
+
+  /**
+   * \return the downlinks announced by the gateways, by destination
+   */
+  static std::multimap<Mac32Address, Time> &GetDownlinks (void);
+
+  /**
+   * Forget all announced downlinks, scheduled at Simulator::Destroy
+   *
+   * \param clearScheduled flag to reset, so the next simulation schedules it again
+   */
+  static void ClearDownlinks (bool *clearScheduled);
 	
   //traceback functions
   TracedCallback<Ptr<const Packet> > m_macTxTrace;
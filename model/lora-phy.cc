@@ -21,6 +21,7 @@
 #include "lora-phy.h"
 #include "lora-spectrum-signal-parameters.h"
 #include "lora-phy-header.h"
+#include "lora-spectrum-channel.h"
 #include <ns3/object.h>
 #include <ns3/spectrum-phy.h>
 #include <ns3/net-device.h>
@@ -34,7 +35,12 @@
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/enum.h>
+#include <ns3/trace-source-accessor.h>
 #include <cmath>
+#include <map>
+#include <algorithm>
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaPhy");
@@ -49,6 +55,46 @@ LoRaPhy::GetTypeId (void)
     .SetParent<SpectrumPhy> ()
 		.SetGroupName("LoRa")
     .AddConstructor<LoRaPhy> ()
+		.AddAttribute ("BinomialBitErrors",
+						"Draw the number of bit errors since the last update from one binomial sample instead of one Bernoulli trial per bit",
+						BooleanValue (true),
+						MakeBooleanAccessor (&LoRaPhy::m_binomialBitErrors),
+						MakeBooleanChecker ())
+		.AddAttribute ("CompensatedSum",
+						"Use Kahan compensated summation when signals are added to and removed from the received power",
+						BooleanValue (false),
+						MakeBooleanAccessor (&LoRaPhy::m_compensatedSum),
+						MakeBooleanChecker ())
+		.AddAttribute ("ReleaseIdleReceiver",
+						"Free the received power buffers whenever no signal is left at the receiver, to save memory in large networks",
+						BooleanValue (false),
+						MakeBooleanAccessor (&LoRaPhy::m_releaseIdleReceiver),
+						MakeBooleanChecker ())
+		.AddAttribute ("SensitivityCheck",
+						"Drop or fold into the background the signals below the noise floor plus noise figure minus the margin",
+						EnumValue (LoRaPhy::SENSITIVITY_OFF),
+						MakeEnumAccessor (&LoRaPhy::m_sensitivityCheck),
+						MakeEnumChecker (LoRaPhy::SENSITIVITY_OFF, "Off",
+								LoRaPhy::SENSITIVITY_IGNORE, "Ignore",
+								LoRaPhy::SENSITIVITY_FOLD, "Fold"))
+		.AddAttribute ("NoiseFigure",
+						"Noise figure of the receiver (dB) used by the sensitivity check",
+						DoubleValue (6.0),
+						MakeDoubleAccessor (&LoRaPhy::m_noiseFigure),
+						MakeDoubleChecker<double> ())
+		.AddAttribute ("SensitivityMargin",
+						"Margin (dB) below the noise floor under which signals are dropped by the sensitivity check",
+						DoubleValue (30.0),
+						MakeDoubleAccessor (&LoRaPhy::m_sensitivityMargin),
+						MakeDoubleChecker<double> ())
+		.AddTraceSource ("DroppedSignal",
+						"A signal was dropped by the sensitivity check",
+						MakeTraceSourceAccessor (&LoRaPhy::m_droppedSignalTrace),
+						"ns3::LoRaPhy::DroppedSignalTracedCallback")
+		.AddTraceSource ("SkippedRx",
+						"A receive window was not opened because nothing could arrive in it",
+						MakeTraceSourceAccessor (&LoRaPhy::m_skippedRxTrace),
+						"ns3::LoRaPhy::SkippedRxTracedCallback")
 		.AddTraceSource ("StateValue",
 						"The state of the transceiver",
 						MakeTraceSourceAccessor (&LoRaPhy::m_state),
@@ -70,23 +116,28 @@ LoRaPhy::LoRaPhy ()
   m_mobility = 0;
   m_channelIndex = 868e4;
   m_channel = 0;
+  m_loraChannel = 0;
   m_netDevice = 0;
   m_random=CreateObject<UniformRandomVariable> ();
   m_random->SetAttribute ("Min",DoubleValue(0.0));
   m_random->SetAttribute ("Max",DoubleValue(1.0));
   m_power = 0.025;
   m_bitErrors = 0;
+  m_binomialBitErrors = true;
 	m_transmission = false;
-  m_errorModel =Create<LoRaErrorModel> (); 
+  m_errorModel =CreateObject<LoRaErrorModel> ();
   InitPowerSpectralDensity ();
-  m_receivingPower = Create<SpectrumValue> (m_rxPsd->GetSpectrumModel ());
-  for (uint8_t i = 0; i<8; i++)
-  {
-    for (uint8_t j=0; j<30; j++)
-    {
-      m_channelUsage[i][j] = 0;
-    }
-  }
+  m_receivingPower = 0;
+  m_receivingSignals = 0;
+  m_releaseIdleReceiver = false;
+  m_compensatedSum = false;
+  m_sensitivityCheck = SENSITIVITY_OFF;
+  m_noiseFigure = 6.0;
+  m_sensitivityMargin = 30.0;
+  m_droppedSignals = 0;
+  m_droppedEnergy = 0.0;
+  m_background = 0;
+  m_maxHalfBandwidth = 0;
 }
 
 LoRaPhy::~LoRaPhy ()
@@ -95,22 +146,33 @@ LoRaPhy::~LoRaPhy ()
   m_netDevice = 0;
   m_mobility = 0;
   m_channel = 0;
+  m_loraChannel = 0;
   m_antenna = 0;
-  m_rxPsd = 0;
+  m_rxSpectrumModel = 0;
 	m_errorModel = 0;
+  delete m_receivingPower;
+  m_receivingPower = 0;
+  delete m_background;
+  m_background = 0;
 }
 
 void
 LoRaPhy::ChangeState (LoRaPhyState state)
 {
   NS_LOG_FUNCTION (this << state);
+	// stop EndRx if phy is stopped: EndOfSignal only ends the current reception
 	if (state == LoRaIDLE)
 	{
-		Simulator::Remove(m_event);
 		m_params = 0;
 	}
   m_state = state;
-	// stop EndRx if phy is stopped
+  UpdateSubscription ();
+}
+
+LoRaPhyState
+LoRaPhy::GetState (void) const
+{
+  return m_state;
 }
 
 
@@ -145,33 +207,225 @@ void
 LoRaPhy::SetChannel (Ptr<SpectrumChannel> c)
 {
   NS_LOG_FUNCTION (this);
-  c->AddRx(this);
+  m_loraChannel = DynamicCast<LoRaSpectrumChannel> (c);
+  if (m_loraChannel != 0)
+  {
+    // only receive signals when the receiver is on
+    m_loraChannel->AddDevice(this);
+    UpdateSubscription ();
+  }
+  else
+  {
+    c->AddRx(this);
+  }
   m_channel = c;
 }
 
 void
-LoRaPhy::InitPowerSpectralDensity ()
+LoRaPhy::UpdateSubscription ()
 {
   NS_LOG_FUNCTION (this);
-  // create offset
-  Bands bands;
-  for (int i= 0; i < 70;i++){
+  if (m_loraChannel == 0)
+    return;
+  if (m_state == LoRaRX)
+    m_loraChannel->Subscribe(this);
+  else
+    m_loraChannel->Unsubscribe(this);
+}
+
+Ptr<const SpectrumModel>
+LoRaPhy::GetDefaultRxSpectrumModel ()
+{
+  // one 70 x 25 kHz receiver grid for the whole simulation, so the channel only needs converters towards this model
+  static Ptr<const SpectrumModel> sm = 0;
+  if (sm == 0)
+  {
+    Bands bands;
+    for (int i= 0; i < 70;i++){
 	BandInfo bi;
 	bi.fl = 868e6+i*25000;
  	bi.fh = 868e6+(i+1)*25000;
 	bi.fc = (bi.fl+bi.fh)/2;
 	bands.push_back (bi);
+    }
+    sm = Create<SpectrumModel> (bands);
+  }
+  return sm;
+}
+
+Ptr<const SpectrumValue>
+LoRaPhy::GetTxPsdTemplate (uint32_t channeloffset, uint32_t bandwidth)
+{
+  // immutable PSD of a 1 W signal, one per (carrier, bandwidth), sharing its SpectrumModel with every transmission on it
+  static std::map<std::pair<uint32_t,uint32_t>, Ptr<const SpectrumValue> > templates;
+  std::pair<uint32_t,uint32_t> key = std::make_pair (channeloffset, bandwidth);
+  std::map<std::pair<uint32_t,uint32_t>, Ptr<const SpectrumValue> >::iterator it = templates.find (key);
+  if (it != templates.end ())
+  {
+    return it->second;
+  }
+  NS_LOG_DEBUG ("new tx spectrum model for " << channeloffset << " " << bandwidth);
+  Bands bands;
+  for (uint32_t i= 0; i < bandwidth/25e3;i++){
+		BandInfo bi;
+		bi.fl = channeloffset*100.0+i*25000-bandwidth/2;
+ 		bi.fh = channeloffset*100.0+(i+1)*25000-bandwidth/2;
+		bi.fc = (bi.fl+bi.fh)/2;
+		bands.push_back (bi);
   }
   Ptr<SpectrumModel> sm = Create<SpectrumModel> (bands);
-  m_rxPsd = Create <SpectrumValue> (sm);
+  Ptr<SpectrumValue> unit = Create<SpectrumValue> (sm);
+  for (uint32_t i= 0; i < bandwidth/25e3;i++){
+		(*unit)[i]=1.0/bandwidth;
+	}
+  templates[key] = unit;
+  return unit;
+}
+
+void
+LoRaPhy::InitPowerSpectralDensity ()
+{
+  NS_LOG_FUNCTION (this);
+  m_rxSpectrumModel = GetDefaultRxSpectrumModel ();
 }
 
 void
 LoRaPhy::SetRxSpectrumModel (Ptr<const SpectrumModel> model)
 {
-	m_rxPsd = 0;
-	m_rxPsd = Create <SpectrumValue> (model);
-  m_receivingPower = Create<SpectrumValue> (m_rxPsd->GetSpectrumModel ());
+  NS_ASSERT_MSG (model->GetNumBands () <= LoRaPowerVector::BANDS, "the receiver only supports the LoRa grid");
+	m_rxSpectrumModel = model;
+  delete m_receivingPower;
+  m_receivingPower = 0;
+  m_receivingSignals = 0;
+}
+
+void
+LoRaPhy::AddReceivingPower (Ptr<const SpectrumValue> psd)
+{
+  NS_LOG_FUNCTION (this);
+  m_receivingSignals++;
+  if (m_receivingPower == 0)
+  {
+    m_receivingPower = new ReceivingPower;
+  }
+  if (!m_compensatedSum)
+  {
+    m_receivingPower->total.Add (*psd);
+    return;
+  }
+  m_receivingPower->total.AddCompensated (*psd, m_receivingPower->error);
+}
+
+void
+LoRaPhy::RemoveReceivingPower (Ptr<const SpectrumValue> psd)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_receivingSignals > 0);
+  m_receivingSignals--;
+  if (m_receivingSignals == 0)
+  {
+    // nothing is received anymore, drop whatever rounding error is left
+    if (m_releaseIdleReceiver)
+    {
+      delete m_receivingPower;
+      m_receivingPower = 0;
+      return;
+    }
+    m_receivingPower->total.Zero ();
+    m_receivingPower->error.Zero ();
+    return;
+  }
+  if (!m_compensatedSum)
+  {
+    m_receivingPower->total.Subtract (*psd);
+    return;
+  }
+  m_receivingPower->total.SubtractCompensated (*psd, m_receivingPower->error);
+}
+
+double
+LoRaPhy::GetNoisePower (Ptr<const SpectrumValue> psd, double first, double last, double &signalPower) const
+{
+  signalPower = 0.0;
+  uint32_t bins = 0;
+  for (int k = first; k<last; k++)
+  {
+    signalPower += (*psd)[k];
+    bins++;
+  }
+  uint32_t start = first;
+  double noise = bins*m_k*m_temperature;
+  if (m_receivingPower != 0)
+  {
+    noise += m_receivingPower->total.Sum (start, start+bins) - signalPower;
+  }
+  if (m_background != 0)
+  {
+    // folded signals only add to the bins they were received on
+    noise += m_background->Sum (start, start+bins);
+  }
+  return noise;
+}
+
+bool
+LoRaPhy::DropBelowSensitivity (Ptr<SpectrumSignalParameters> params)
+{
+  if (m_sensitivityCheck == SENSITIVITY_OFF)
+  {
+    return false;
+  }
+  double threshold = m_k*m_temperature*std::pow (10.0, (m_noiseFigure-m_sensitivityMargin)/10.0);
+  double peak = 0.0;
+  double sum = 0.0;
+  uint32_t bins = 0;
+  for (Values::const_iterator it = params->psd->ConstValuesBegin (); it != params->psd->ConstValuesEnd (); it++)
+  {
+    peak = std::max (peak, *it);
+    sum += *it;
+    bins++;
+  }
+  if (peak >= threshold)
+  {
+    return false;
+  }
+  NS_LOG_LOGIC ("signal below sensitivity " << peak << " < " << threshold);
+  // every bin is 25 kHz wide
+  double power = sum*25e3;
+  m_droppedSignals++;
+  m_droppedEnergy += power*params->duration.GetSeconds ();
+  if (m_sensitivityCheck == SENSITIVITY_FOLD && bins > 0)
+  {
+    // close the SINR pieces that did not see this signal yet
+    UpdateBer ();
+    if (m_background == 0)
+    {
+      m_background = new LoRaPowerVector;
+    }
+    m_background->Add (*params->psd);
+    // removed by UpdateBer once it is off the air, without an event per signal
+    m_backgroundEnds.insert (std::make_pair (Simulator::Now ()+params->duration, params->psd));
+  }
+  m_droppedSignalTrace (power, params->duration);
+  return true;
+}
+
+uint32_t
+LoRaPhy::GetDroppedSignals (void) const
+{
+  return m_droppedSignals;
+}
+
+double
+LoRaPhy::GetDroppedEnergy (void) const
+{
+  return m_droppedEnergy;
+}
+
+void
+LoRaPhy::SkipReception (Time duration)
+{
+  NS_LOG_FUNCTION (this << duration);
+  m_skippedRxTrace (duration);
 }
 
 Ptr<SpectrumValue>
@@ -180,46 +434,26 @@ LoRaPhy::GetFullTxPowerSpectralDensity (uint32_t channeloffset, double power)
   NS_LOG_FUNCTION(this);
   // 3 banden, waarvan een heel groot deel niet gebruikt worden. 
   double txPowerDensity = power/m_bandwidth;
-  //reset m_rxPsd
-  for (uint32_t i = 0; i<70; i++)
-  {
-    (*m_rxPsd)[i]=0;
-  }
-  //and fill it
+  Ptr<SpectrumValue> psd = Create<SpectrumValue> (m_rxSpectrumModel);
   for (uint8_t j = (channeloffset-868e4)/250-m_bandwidth/2/25000; j<(channeloffset-868e4)/250+m_bandwidth/2/25000+1; j++){
-  	(*m_rxPsd)[j] = txPowerDensity;
+  	(*psd)[j] = txPowerDensity;
   }
-  return m_rxPsd->Copy ();
+  return psd;
 }
 
 Ptr<SpectrumValue>
 LoRaPhy::GetTxPowerSpectralDensity (uint32_t channeloffset, double power)
 {
   NS_LOG_FUNCTION(this << channeloffset << power);
-  // 3 banden, waarvan een heel groot deel niet gebruikt worden. 
-  double txPowerDensity = power/m_bandwidth;
-  //and fill it
-  Bands bands;
-  for (int i= 0; i < m_bandwidth/25e3;i++){
-		BandInfo bi;
-		bi.fl = channeloffset*100+i*25000-m_bandwidth/2;
- 		bi.fh = channeloffset*100+(i+1)*25000-m_bandwidth/2;
-		bi.fc = (bi.fl+bi.fh)/2;
-		bands.push_back (bi);
-  }
-  Ptr<SpectrumModel> sm = Create<SpectrumModel> (bands);
-	Ptr<SpectrumValue> test = Create<SpectrumValue> (sm);
-  for (int i= 0; i < m_bandwidth/25e3;i++){
-		(*test)[i]=txPowerDensity;
-	}
-  return test->Copy ();
+  // scale the shared unit power template, the spectrum model is not copied
+  return Create<SpectrumValue> ((*GetTxPsdTemplate (channeloffset, m_bandwidth))*power);
 }
 
 Ptr<const SpectrumModel>
 LoRaPhy::GetRxSpectrumModel () const
 {
   NS_LOG_FUNCTION (this);
-  return m_rxPsd->GetSpectrumModel ();
+  return m_rxSpectrumModel;
 }
 
 void
@@ -236,11 +470,29 @@ LoRaPhy::GetRxAntenna ()
   return m_antenna;
 }
 
+void
+LoRaPhy::SetErrorModel (Ptr<LoRaErrorModel> model)
+{
+  NS_LOG_FUNCTION (this << model);
+  m_errorModel = model;
+}
+
+void
+LoRaPhy::SetRandomVariable (Ptr<UniformRandomVariable> random)
+{
+  NS_LOG_FUNCTION (this << random);
+  m_random = random;
+}
+
 void
 LoRaPhy::SetChannelIndex (uint32_t channel)
 {
 	NS_LOG_FUNCTION (this);
-    m_channelIndex = channel;
+  // a channel split in sub-bands has to move the listener to the new frequency
+  if (m_loraChannel != 0 && channel != m_channelIndex)
+    m_loraChannel->Unsubscribe(this);
+  m_channelIndex = channel;
+  UpdateSubscription ();
 }
 
 uint32_t
@@ -290,6 +542,12 @@ LoRaPhy::SetSpreadingFactor (uint8_t sf){
 	m_spreadingfactor = sf;
 }
 
+uint8_t
+LoRaPhy::GetSpreadingFactor (void) const
+{
+	return m_spreadingfactor;
+}
+
 	void
 LoRaPhy::SetBandwidth (uint32_t bandwidth)
 {
@@ -297,6 +555,12 @@ LoRaPhy::SetBandwidth (uint32_t bandwidth)
 	m_bandwidth = bandwidth;
 }
 
+uint32_t
+LoRaPhy::GetBandwidth (void) const
+{
+	return m_bandwidth;
+}
+
 	void
 LoRaPhy::SetPower (double power)
 {
@@ -304,6 +568,12 @@ LoRaPhy::SetPower (double power)
 	m_power = power;
 }
 
+double
+LoRaPhy::GetPower (void) const
+{
+	return m_power;
+}
+
 	void
 LoRaPhy::SetTransmissionEndCallback (Callback<void, Ptr<const Packet> > callback)
 {
@@ -373,24 +643,32 @@ LoRaPhy::EndTx (Ptr<Packet> packet)
 {
 	NS_LOG_FUNCTION (this);
 	m_state = LoRaIDLE;
+	UpdateSubscription ();
 	m_transmission = false;
 	LoRaPhyHeader lh;
 	packet->RemoveHeader(lh);
-	m_transmissionEnd (packet);
+	// the analytic shadows of the validation mode have no MAC
+	if (!m_transmissionEnd.IsNull ())
+		m_transmissionEnd (packet);
 }
 
 	void
 LoRaPhy::StartRx (Ptr<SpectrumSignalParameters> params)
 {
 	NS_LOG_FUNCTION (this);
+	//signals far below the noise floor need no events at all
+	if (DropBelowSensitivity (params))
+	{
+		return;
+	}
 	//update BER
 	UpdateBer();
 	//Check if params are from LoRa
 	Ptr<LoRaSpectrumSignalParameters> sfParams = DynamicCast<LoRaSpectrumSignalParameters> (params);
 	// add power to received power
-	*m_receivingPower += *params->psd;
-	//Schedule the end of the noise
-	Simulator::Schedule(params->duration,&LoRaPhy::EndNoise,this,params->psd);
+	AddReceivingPower (params->psd);
+	//Schedule the end of the noise, the signal and the reception at once
+	Simulator::Schedule(params->duration,&LoRaPhy::EndOfSignal,this,params);
 	if (sfParams != 0){
 		//Get parameters of the current received signal parameters
 		uint32_t channel = sfParams->GetChannel();
@@ -400,34 +678,44 @@ LoRaPhy::StartRx (Ptr<SpectrumSignalParameters> params)
 		NS_ASSERT(channel > 8680000);
 		NS_ASSERT(bandwidth > 100000);
 		uint8_t error = 0;
-		//Add signal to channel usage matrix
-		for (uint8_t i = (channel-8680000-bandwidth/200)/250; i <= (channel-8680000+bandwidth/200)/250; i++){
-			if ((*sfParams->psd)[i]!=0){
-				error = error + (m_channelUsage[((12-spreading)+(bandwidth/125000-1))][i]>(*sfParams->psd)[i]);
-				m_channelUsage[((12-spreading)+(bandwidth/125000-1))][i]=(m_channelUsage[((12-spreading)+(bandwidth/125000-1))][i]+(*sfParams->psd)[i]);
+		uint32_t sfClass = bandwidth << (12-spreading);
+		double power = GetInBandPower (sfParams);
+		//the signal is lost if the active signals of the same SF class on an overlapping channel are stronger
+		m_maxHalfBandwidth = std::max (m_maxHalfBandwidth, bandwidth/200);
+		UsageLedger::const_iterator it = m_channelUsage.lower_bound (std::make_pair (sfClass, channel-bandwidth/200-m_maxHalfBandwidth));
+		for (; it != m_channelUsage.end () && it->first.first == sfClass && it->first.second < channel+bandwidth/200+m_maxHalfBandwidth; it++)
+		{
+			Ptr<LoRaSpectrumSignalParameters> other = it->second.byEnd.begin ()->second.first;
+			if (other->GetChannel()+other->GetBandwidth()/200 > channel-bandwidth/200 && other->GetChannel()-other->GetBandwidth()/200 < channel+bandwidth/200)
+			{
+				error = error + (it->second.total > power);
 			}
 		}
-		// Remove interfering signals from the list
-		Simulator::Schedule(sfParams->duration,&LoRaPhy::EndSignal,this,sfParams->psd,channel,spreading,bandwidth);
+		//Add signal to the ledger of active transmissions
+		ChannelLedger &ledger = m_channelUsage[std::make_pair (sfClass, channel)];
+		if (ledger.byEnd.empty ())
+		{
+			ledger.total = 0.0;
+		}
+		ledger.byEnd.insert (std::make_pair (Simulator::Now ()+sfParams->duration, std::make_pair (sfParams, power)));
+		ledger.powers.insert (power);
+		ledger.total += power;
 		// if there is already something transmitting it should be checked if the new values interfere with the current signal parameters
 		if (m_params!=0)
 		{
-			double powerInterferer = 0.0;
-			double powerReceiver = 0.0;
-			for (uint8_t i = (channel-8680000-bandwidth/200)/250; i<= (channel-8680000+bandwidth/200)/250; i++)
-			{
-				powerInterferer+= (*sfParams->psd)[i];
-				powerReceiver+= (*m_params->psd)[i];
-			}
-			//if the parameters fall together
-			if (m_params->GetChannel() - channel < (m_params->GetBandwidth()+bandwidth)/200 && (12-spreading + bandwidth/125000-1) == (12-m_params->GetSpreading()+m_params->GetBandwidth()/125000-1) && powerInterferer * 4 > powerReceiver)
+			//if the parameters fall together: overlapping channels and the same chirp rate
+			uint32_t distance = m_params->GetChannel() > channel ? m_params->GetChannel() - channel : channel - m_params->GetChannel();
+			uint32_t receivingClass = m_params->GetBandwidth() << (12-m_params->GetSpreading());
+			//the reception survives as long as it is 6 dB above the strongest interferer of its SF class
+			if (distance < (m_params->GetBandwidth()+bandwidth)/200 && sfClass == receivingClass
+					&& GetStrongestInterferer (m_params->GetChannel(), m_params->GetSpreading(), m_params->GetBandwidth(), m_params) * 4 > GetInBandPower (m_params))
 			{
 				//packet is lost
-				Simulator::Remove(m_event);
 				m_ReceptionError();
 				m_params = 0;
 				error ++;
 				m_state = LoRaIDLE;
+				UpdateSubscription ();
 			}
 		}
 		//if the settings of the transceiver are ok, then continue
@@ -438,8 +726,6 @@ LoRaPhy::StartRx (Ptr<SpectrumSignalParameters> params)
 			{
 				m_params=sfParams;
 				m_bitErrors=0;
-				//generate ending event
-				m_event =Simulator::Schedule(sfParams->duration,&LoRaPhy::EndRx,this,sfParams);
 				if(sfParams->duration.GetSeconds() > 17.0*8.0/GetBitRate(m_spreadingfactor))
 				{
 					Simulator::Schedule(Seconds(17.0*8.0/GetBitRate(m_spreadingfactor)),&LoRaPhy::SendMac,this);
@@ -469,13 +755,89 @@ LoRaPhy::SendMac ()
 }
 
 	void
-LoRaPhy::EndSignal (Ptr<SpectrumValue> sv, uint32_t frequency, uint8_t spreading, uint32_t bandwidth)
+LoRaPhy::EndOfSignal (Ptr<SpectrumSignalParameters> params)
+{
+	NS_LOG_FUNCTION (this << params);
+	//update BER because noise is changing
+	UpdateBer();
+	Ptr<LoRaSpectrumSignalParameters> sfParams = DynamicCast<LoRaSpectrumSignalParameters> (params);
+	if (sfParams != 0)
+	{
+		// Remove signal from the receiving list
+		EndSignal (sfParams);
+		// a reception that was lost or stopped is no longer in m_params
+		if (sfParams == m_params)
+		{
+			EndRx (sfParams);
+		}
+	}
+	// remove noise source
+	RemoveReceivingPower (params->psd);
+}
+
+	void
+LoRaPhy::EndSignal (Ptr<LoRaSpectrumSignalParameters> params)
 {
 	NS_LOG_FUNCTION (this);
-	// Remove signal from detailed receiving list
-	for (uint8_t i = (frequency-8680000-bandwidth/200)/250; i <= (frequency-8680000+bandwidth/200)/250; i++){
-		m_channelUsage[(((12-spreading)+(bandwidth/125000-1)))][i]= m_channelUsage[(((12-spreading)+(bandwidth/125000-1)))][i]-(*sv)[i];
-	} 
+	// Remove signal from the ledger, it ends now
+	UsageLedger::iterator it = m_channelUsage.find (std::make_pair (params->GetBandwidth() << (12-params->GetSpreading()), params->GetChannel()));
+	NS_ASSERT (it != m_channelUsage.end ());
+	ChannelLedger &ledger = it->second;
+	std::pair<std::multimap<Time, std::pair<Ptr<LoRaSpectrumSignalParameters>, double> >::iterator, std::multimap<Time, std::pair<Ptr<LoRaSpectrumSignalParameters>, double> >::iterator> range = ledger.byEnd.equal_range (Simulator::Now ());
+	for (; range.first != range.second; range.first++)
+	{
+		if (range.first->second.first == params)
+		{
+			ledger.powers.erase (ledger.powers.find (range.first->second.second));
+			ledger.total -= range.first->second.second;
+			ledger.byEnd.erase (range.first);
+			break;
+		}
+	}
+	if (ledger.byEnd.empty ())
+	{
+		m_channelUsage.erase (it);
+	}
+}
+
+	double
+LoRaPhy::GetStrongestInterferer (uint32_t channel, uint8_t spreading, uint32_t bandwidth, Ptr<LoRaSpectrumSignalParameters> exclude) const
+{
+	uint32_t sfClass = bandwidth << (12-spreading);
+	double excluded = exclude != 0 ? GetInBandPower (exclude) : 0.0;
+	double strongest = 0.0;
+	UsageLedger::const_iterator it = m_channelUsage.lower_bound (std::make_pair (sfClass, channel-bandwidth/200-m_maxHalfBandwidth));
+	for (; it != m_channelUsage.end () && it->first.first == sfClass && it->first.second < channel+bandwidth/200+m_maxHalfBandwidth; it++)
+	{
+		Ptr<LoRaSpectrumSignalParameters> other = it->second.byEnd.begin ()->second.first;
+		if (other->GetChannel()+other->GetBandwidth()/200 > channel-bandwidth/200 && other->GetChannel()-other->GetBandwidth()/200 < channel+bandwidth/200)
+		{
+			std::multiset<double>::const_reverse_iterator power = it->second.powers.rbegin ();
+			// the excluded signal is only in the ledger of its own channel and SF class
+			if (exclude != 0 && it->first.second == exclude->GetChannel() && *power == excluded)
+			{
+				power++;
+			}
+			if (power != it->second.powers.rend ())
+			{
+				strongest = std::max (strongest, *power);
+			}
+		}
+	}
+	return strongest;
+}
+
+	double
+LoRaPhy::GetInBandPower (Ptr<LoRaSpectrumSignalParameters> params)
+{
+	uint32_t channel = params->GetChannel();
+	uint32_t bandwidth = params->GetBandwidth();
+	double power = 0.0;
+	for (int k = (channel-868e4-bandwidth/200)/250+1; k < (channel-868e4+bandwidth/200)/250+1; k++)
+	{
+		power += (*params->psd)[k]*25e3;
+	}
+	return power;
 }
 
 	void
@@ -485,17 +847,19 @@ LoRaPhy::EndNoise (Ptr<SpectrumValue> sv)
 	//update BER because noise is changing
 	this->UpdateBer();
 	// remove noise source
-	*m_receivingPower -= *sv;
+	RemoveReceivingPower (sv);
 }
 
 	void 
 LoRaPhy::EndRx (Ptr<LoRaSpectrumSignalParameters> params)
 {
 	NS_LOG_FUNCTION(this);
-	//update BER
-	UpdateBer();
+	//the BER was updated by EndOfSignal
 	//Reception has ended, so clear receiving parameters
 	m_params=0;
+	//score the whole SINR timeline of the packet at once
+	m_bitErrors = params->GetBer() + GetBitErrors (params);
+	params->SetBer(m_bitErrors);
 	//decide packet error or not
 	Ptr<Packet> packet = params->packet;
 	// remove lora header
@@ -516,28 +880,81 @@ LoRaPhy::EndRx (Ptr<LoRaSpectrumSignalParameters> params)
 	}
 	// turn of receiver
 	m_state = LoRaIDLE;
+	UpdateSubscription ();
+}
+
+	uint32_t
+LoRaPhy::GetBitErrors (Ptr<LoRaSpectrumSignalParameters> params)
+{
+	NS_LOG_FUNCTION (this);
+	uint32_t bitErrors = 0;
+	uint8_t spreading = params->GetSpreading();
+	uint32_t bandwidth = params->GetBandwidth();
+	int bitrate = round(bandwidth*spreading/pow(2,spreading));
+	const std::vector<std::pair<double,double> > &segments = params->GetSinrSegments();
+	//getBER of the whole timeline at once
+	std::vector<double> sinr (segments.size());
+	std::vector<long double> ber;
+	for (uint32_t i = 0; i < segments.size(); i++)
+	{
+		sinr[i] = segments[i].second;
+	}
+	m_errorModel->GetBER (sinr, spreading, bandwidth, ber);
+	for (uint32_t i = 0; i < segments.size(); i++)
+	{
+		long double berEs = ber[i];
+		//calculate numbers of biterrors
+		uint16_t bits = segments[i].first * bitrate;
+		if (m_binomialBitErrors)
+		{
+			bitErrors += m_errorModel->GetBitErrors (berEs, bits, m_random->GetValue());
+		}
+		else
+		{
+			for (uint16_t b = 0; b<bits; b++)
+			{
+				if(m_random->GetValue()<berEs)
+				{
+					bitErrors+=1;
+				}
+			}
+		}
+	}
+	return bitErrors;
 }
 
 	void 
 LoRaPhy::UpdateBer ()
 {
 	NS_LOG_FUNCTION (this);
-	// save current Time
-	double timeNow = Simulator::Now().GetSeconds(); 
+	// every folded signal that ended since the last check ends a SINR piece
+	Time now = Simulator::Now ();
+	while (!m_backgroundEnds.empty () && m_backgroundEnds.begin ()->first <= now)
+	{
+		AddSinrSegments (m_backgroundEnds.begin ()->first.GetSeconds ());
+		m_background->Subtract (*m_backgroundEnds.begin ()->second);
+		m_backgroundEnds.erase (m_backgroundEnds.begin ());
+		if (m_backgroundEnds.empty ())
+		{
+			// reset when idle, so rounding errors do not accumulate
+			m_background->Zero ();
+		}
+	}
+	AddSinrSegments (now.GetSeconds ());
+}
+
+	void 
+LoRaPhy::AddSinrSegments (double timeNow)
+{
+	NS_LOG_FUNCTION (this << timeNow);
 	// if nothing in receing parameters, there is nothing to do
 	if (m_params!=0)
 	{
 		//calculate SNR
-		Ptr<SpectrumValue> noise = m_receivingPower->Copy();
-		*noise -= *m_params->psd; 
 		double signalPower = 0.0;
 		uint32_t bandwidth = m_params->GetBandwidth();
 		uint32_t freq = m_params->GetChannel();
-		double noisePower = 0.0;
-		for ( int k = (freq-868e4-bandwidth/200)/250; k<(freq-868e4+bandwidth/200)/250; k++){
-			signalPower += (*m_params->psd)[k];
-			noisePower += ((*noise)[k]+m_k*m_temperature);
-		}
+		double noisePower = GetNoisePower (m_params->psd, (freq-868e4-bandwidth/200)/250, (freq-868e4+bandwidth/200)/250, signalPower);
 
 		double snr = signalPower/noisePower;
 		// guard this, because this function is called twice at the end of a packet
@@ -546,19 +963,8 @@ LoRaPhy::UpdateBer ()
 			m_lastSnr = 10*std::log10(snr);
 		}
 		NS_LOG_DEBUG("The SNR: " << snr << " " << signalPower << " " << noisePower);
-		//getBER
-		long double berEs = m_errorModel->GetBER (snr, m_params->GetSpreading(), m_bandwidth);
-		//calculate numbers of biterrors
-		uint16_t bits = (timeNow-m_lastCheck) * GetBitRate(m_spreadingfactor);
-		m_bitErrors = m_params->GetBer();
-		for (uint16_t it = 0; it<bits; it++)
-		{
-			if(m_random->GetValue()<berEs)
-			{
-				m_bitErrors+=1;
-			}
-		}
-		m_params->SetBer(m_bitErrors);
+		// the SNR has been constant since the last check, the bit errors are only drawn at the end of the reception
+		m_params->AddSinrSegment (timeNow-m_lastCheck, snr);
 	}
 	//update time 
 	m_lastCheck = timeNow;
@@ -28,15 +28,20 @@
 #include <ns3/spectrum-phy.h>
 #include "lora-error-model.h"
 #include "lora-spectrum-signal-parameters.h"
+#include "lora-power-vector.h"
 #include "lora-mac-header.h"
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/callback.h>
 #include <ns3/traced-value.h>
 #include <ns3/traced-callback.h>
+#include <vector>
+#include <map>
+#include <set>
 namespace ns3 {
 
 class SpectrumChannel;
+class LoRaSpectrumChannel;
 class MobilityModel;
 class AntennaModel;
 class SpectrumValue;
@@ -73,7 +78,31 @@ class LoRaPhy : public SpectrumPhy
 {
 
 public:
-	
+
+  /**
+   * What happens with signals below the sensitivity threshold
+   */
+  enum SensitivityCheck
+  {
+    SENSITIVITY_OFF, //!< every signal is received
+    SENSITIVITY_IGNORE, //!< weak signals are dropped
+    SENSITIVITY_FOLD //!< weak signals are folded into a background term per bin while they are on the air
+  };
+
+  /**
+   * TracedCallback signature for signals dropped by the sensitivity check.
+   *
+   * \param power received power of the signal (W)
+   * \param duration duration of the signal
+   */
+  typedef void (* DroppedSignalTracedCallback) (double power, Time duration);
+
+  /**
+   * TracedCallback signature for receive windows that were not opened.
+   *
+   * \param duration time the receiver would have been on
+   */
+  typedef void (* SkippedRxTracedCallback) (Time duration);
 
 
 	LoRaPhy ();
@@ -141,6 +170,22 @@ public:
   Ptr<AntennaModel> GetRxAntenna ();
   void SetRxAntenna (Ptr<AntennaModel> a);
 
+  /**
+   * Replace the error model, for example by one shared by many phys.
+   * The error model has no state of its own besides its attributes.
+   *
+   * \param model the error model
+   */
+  void SetErrorModel (Ptr<LoRaErrorModel> model);
+
+  /**
+   * Replace the uniform random variable that decides the bit errors,
+   * for example by one shared by many phys.
+   *
+   * \param random a uniform random variable in [0,1)
+   */
+  void SetRandomVariable (Ptr<UniformRandomVariable> random);
+
   /**
    * Notify the SpectrumPhy instance of an incoming signal
    *
@@ -155,6 +200,14 @@ public:
    */
   void EndRx (Ptr<LoRaSpectrumSignalParameters> params);
 
+  /**
+   * Single end event of an incoming signal: update the BER, end the
+   * reception if the signal was being received and remove its power.
+   *
+   * \param params the parameters of the signal that ends
+   */
+  void EndOfSignal (Ptr<SpectrumSignalParameters> params);
+
   /**
    * Remove noise from the received signals
    *
@@ -163,13 +216,22 @@ public:
   void EndNoise (Ptr<SpectrumValue> sv);
 
   /**
-   * Remove a signal from the receiving list. This is for LoRa signals
+   * Remove a signal from the ledger of active transmissions. This is for LoRa signals
+   *
+   * \param params the signal that ends
+   */
+  void EndSignal (Ptr<LoRaSpectrumSignalParameters> params);
+
+  /**
+   * Get the strongest active signal of the same SF class overlapping a channel
    *
-   * \param frequency the carrier frequency of the signal 
-   * \param spreading the spreading of the lora signal
-   * \param bandwidth the bandwidth of the signal 
+   * \param channel the carrier frequency (*100Hz)
+   * \param spreading the spreading factor
+   * \param bandwidth the bandwidth
+   * \param exclude a signal in the ledger that is not counted, e.g. the one being received
+   * \return the in-band power of the strongest interferer (W), 0 if there is none
    */
-  void EndSignal (Ptr<SpectrumValue> sv, uint32_t frequency, uint8_t spreading, uint32_t bandwidth);
+  double GetStrongestInterferer (uint32_t channel, uint8_t spreading, uint32_t bandwidth, Ptr<LoRaSpectrumSignalParameters> exclude = 0) const;
 
   /**
    * Set callback function when packet has been transmitted
@@ -219,6 +281,7 @@ public:
    * \params sf spreading factor
    */
   void SetSpreadingFactor (uint8_t sf);
+  uint8_t GetSpreadingFactor (void) const;
 
   /**
    * Set bandwidth of the transceiver
@@ -226,6 +289,7 @@ public:
    * \params bandwidth bandwidth of the signal
    */
   void SetBandwidth (uint32_t bandwidth);
+  uint32_t GetBandwidth (void) const;
 
   /**
    * Set power of the transmitter
@@ -233,6 +297,7 @@ public:
    * \params power power of the transmitter
    */
   void SetPower (double power);
+  double GetPower (void) const;
 
   /**
    * get the bitrate of the current settings
@@ -254,6 +319,7 @@ public:
    * \params sf spreading factor
    */
   void ChangeState (LoRaPhyState state);
+  LoRaPhyState GetState (void) const;
 
   /**
    * Get Transmit power spectral density for a given channel and power and the stored bandwidth and spreading
@@ -287,6 +353,13 @@ public:
 		*/
 	double GetSnrLastPacket (void);
 
+  /**
+   * Get the receiver spectrum model shared by all LoRa transceivers
+   *
+   * \return the 70 band model of 25 kHz starting at 868 MHz
+   */
+  static Ptr<const SpectrumModel> GetDefaultRxSpectrumModel ();
+
 	/**
 		* Check if physical layer is transmitting 
 		* 
@@ -294,12 +367,44 @@ public:
 		*/
 	bool IsTransmitting ();
 
+  /**
+   * Get the number of signals dropped by the sensitivity check
+   *
+   * \return the number of dropped signals
+   */
+  uint32_t GetDroppedSignals (void) const;
+
+  /**
+   * Get the energy of the signals dropped by the sensitivity check
+   *
+   * \return the dropped energy (J)
+   */
+  double GetDroppedEnergy (void) const;
+
+  /**
+   * Account for a receive window the MAC did not open because nothing could arrive in it.
+   * The state does not change, the window is only reported to the energy model.
+   *
+   * \param duration time the receiver would have been on
+   */
+  void SkipReception (Time duration);
+
 protected:
 
+  /**
+   * Drop a signal whose power density stays below the thermal noise plus
+   * noise figure minus the margin in every bin.
+   *
+   * \param params the incoming signal
+   * \return true if the signal should not be received
+   */
+  bool DropBelowSensitivity (Ptr<SpectrumSignalParameters> params);
+
  Ptr<NetDevice> m_netDevice; //!<upper layer
  Ptr<MobilityModel> m_mobility; //!<position
  Ptr<SpectrumChannel> m_channel; //!<channel to transmit on
- Ptr<SpectrumValue> m_rxPsd; //!<Current psd
+ Ptr<LoRaSpectrumChannel> m_loraChannel; //!<same channel if it only delivers to listening receivers
+ Ptr<const SpectrumModel> m_rxSpectrumModel; //!< spectrum model of the receiver
  Ptr<AntennaModel> m_antenna; //!<antenna to be used
 
 
@@ -314,8 +419,40 @@ protected:
  //Ptr<LoRaSpectrumSignalParameters> m_param; //!< 
  double m_bitErrors; //!< biterrors collected 
  double m_lastCheck; //!< last time check
- Ptr<SpectrumValue> m_receivingPower; //!< all the power at the receiving antenna
- double m_channelUsage [8][30]; //!< table with all the information of the current transmissions
+ bool m_binomialBitErrors; //!< sample the bit errors of an interval at once instead of bit per bit
+  /**
+   * Power at the receiving antenna, only allocated once a signal arrives
+   */
+  struct ReceivingPower
+  {
+    LoRaPowerVector total; //!< all the power at the receiving antenna
+    LoRaPowerVector error; //!< running compensation of total in compensated mode
+  };
+ ReceivingPower *m_receivingPower; //!< power at the receiving antenna, 0 before the first signal
+ uint32_t m_receivingSignals; //!< number of signals in m_receivingPower
+ bool m_releaseIdleReceiver; //!< free m_receivingPower whenever no signal is left
+ bool m_compensatedSum; //!< use Kahan summation to update m_receivingPower
+ SensitivityCheck m_sensitivityCheck; //!< what to do with signals below the sensitivity threshold
+ double m_noiseFigure; //!< noise figure of the receiver (dB)
+ double m_sensitivityMargin; //!< margin of the threshold below the noise floor (dB)
+ uint32_t m_droppedSignals; //!< signals dropped by the sensitivity check
+ double m_droppedEnergy; //!< energy of the dropped signals (J)
+ LoRaPowerVector *m_background; //!< power of the folded signals on the air, 0 before the first one
+ std::multimap<Time, Ptr<const SpectrumValue> > m_backgroundEnds; //!< folded signals by the end of their transmission
+ TracedCallback<double, Time> m_droppedSignalTrace; //!< signal dropped by the sensitivity check
+ TracedCallback<Time> m_skippedRxTrace; //!< receive window that was not opened
+  /**
+   * Active LoRa signals of one SF class on one channel
+   */
+  struct ChannelLedger
+  {
+    std::multimap<Time, std::pair<Ptr<LoRaSpectrumSignalParameters>, double> > byEnd; //!< signals and their in-band power by end time
+    std::multiset<double> powers; //!< in-band power of the signals, the strongest last
+    double total; //!< sum of the in-band powers
+  };
+  typedef std::map<std::pair<uint32_t, uint32_t>, ChannelLedger> UsageLedger; //!< ledgers keyed by (SF class, channel)
+ UsageLedger m_channelUsage; //!< all the current LoRa transmissions
+ uint32_t m_maxHalfBandwidth; //!< half of the widest signal in the ledger (*100Hz)
  Ptr<LoRaErrorModel> m_errorModel; //!< error model for this device
  Ptr<UniformRandomVariable> m_random; //!< determines whether received package is lost are not
  //callbackfunctions
@@ -324,9 +461,48 @@ protected:
  Callback<void> m_ReceptionError;
  Callback<void, Ptr<Packet>,double> m_ReceptionEnd;
 
+  /**
+   * Add a signal to the power at the receiving antenna
+   *
+   * \param psd the signal expressed in the receiver spectrum model
+   */
+  void AddReceivingPower (Ptr<const SpectrumValue> psd);
+
+  /**
+   * Remove a signal from the power at the receiving antenna.
+   * When no signal is left, the total is reset to zero so no rounding error survives.
+   *
+   * \param psd the signal expressed in the receiver spectrum model
+   */
+  void RemoveReceivingPower (Ptr<const SpectrumValue> psd);
+
+  /**
+   * \param params a LoRa signal
+   * \return the power of the signal in its own band (W), as kept in the ledger
+   */
+  static double GetInBandPower (Ptr<LoRaSpectrumSignalParameters> params);
+
+  /**
+   * Get the noise and interference seen by a signal in its band, without copying the receiving power
+   *
+   * \param psd the wanted signal
+   * \param first first bin of the band (truncated)
+   * \param last bins strictly below this bound belong to the band
+   * \param signalPower (out) the power of the wanted signal in the band
+   * \return the power of noise and all other signals in the band
+   */
+  double GetNoisePower (Ptr<const SpectrumValue> psd, double first, double last, double &signalPower) const;
+
+  /**
+   * Draw the bit errors of a finished reception from its SINR timeline
+   *
+   * \param params the reception with all its (duration, sinr) pieces
+   * \return the number of bit errors in the packet
+   */
+  uint32_t GetBitErrors (Ptr<LoRaSpectrumSignalParameters> params);
+
 private:
  
- EventId m_event; //!< When the receiving packet is being received
  TracedValue<LoRaPhyState> m_state; //!< state of the transceiver
  double m_lastRssi; //!< rssi of last packet
  double m_lastSnr; //!< snr of last packet
@@ -340,6 +516,22 @@ private:
   */
   void CreateTxPowerSpectralDensity (uint32_t channeloffset, double power);
 
+  /**
+   * Get the cached PSD of a signal of 1 W for the given carrier and bandwidth.
+   * All transmissions with the same settings share this spectrum model.
+   *
+   * \param channeloffset carrierfrequency of the signal (*100Hz)
+   * \param bandwidth bandwidth of the signal
+   * \return the unit power PSD, which must not be modified
+   */
+  static Ptr<const SpectrumValue> GetTxPsdTemplate (uint32_t channeloffset, uint32_t bandwidth);
+
+  /**
+   * Subscribe to the channel when the receiver is on and unsubscribe otherwise.
+   * This only matters on a LoRaSpectrumChannel.
+   */
+  void UpdateSubscription ();
+
   /**
    * Send the MAC header to the MAC-layer when this is received, this is needed to open the second receive slot.
    */
@@ -348,9 +540,17 @@ private:
  Callback<void, LoRaMacHeader > m_ReceptionMacEnd; 
 
   /**
-   * Update the BER for all receiving transmissions based on latest information 
+   * Close the current SINR piece of all receiving transmissions based on latest information.
+   * Folded signals that went off the air since the last update end a piece first.
+   */
+  void UpdateBer (void);
+
+  /**
+   * Add a SINR piece from the last check until the given time to all receiving transmissions
+   *
+   * \param timeNow the end of the piece (s)
    */
-  virtual void UpdateBer (void);
+  virtual void AddSinrSegments (double timeNow);
 };
 
 
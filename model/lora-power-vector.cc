@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-power-vector.h"
+#include <ns3/log.h>
+#if defined (__AVX__) || defined (__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaPowerVector");
+
+const uint32_t LoRaPowerVector::BANDS;
+const uint32_t LoRaPowerVector::PADDED;
+
+LoRaPowerVector::LoRaPowerVector ()
+{
+  Zero ();
+}
+
+const double *
+LoRaPowerVector::GetValues (const SpectrumValue &psd, uint32_t &n)
+{
+  n = psd.GetSpectrumModel ()->GetNumBands ();
+  NS_ASSERT_MSG (n <= BANDS, "the signal is not on the LoRa receiver grid");
+  return &(*psd.ConstValuesBegin ());
+}
+
+void
+LoRaPowerVector::Add (const SpectrumValue &psd)
+{
+  uint32_t n;
+  const double *src = GetValues (psd, n);
+  uint32_t k = 0;
+#if defined (__AVX__)
+  for (; k+4 <= n; k += 4)
+    {
+      _mm256_storeu_pd (m_values+k, _mm256_add_pd (_mm256_loadu_pd (m_values+k), _mm256_loadu_pd (src+k)));
+    }
+#elif defined (__SSE2__)
+  for (; k+2 <= n; k += 2)
+    {
+      _mm_storeu_pd (m_values+k, _mm_add_pd (_mm_loadu_pd (m_values+k), _mm_loadu_pd (src+k)));
+    }
+#endif
+  for (; k < n; k++)
+    {
+      m_values[k] += src[k];
+    }
+}
+
+void
+LoRaPowerVector::Subtract (const SpectrumValue &psd)
+{
+  uint32_t n;
+  const double *src = GetValues (psd, n);
+  uint32_t k = 0;
+#if defined (__AVX__)
+  for (; k+4 <= n; k += 4)
+    {
+      _mm256_storeu_pd (m_values+k, _mm256_sub_pd (_mm256_loadu_pd (m_values+k), _mm256_loadu_pd (src+k)));
+    }
+#elif defined (__SSE2__)
+  for (; k+2 <= n; k += 2)
+    {
+      _mm_storeu_pd (m_values+k, _mm_sub_pd (_mm_loadu_pd (m_values+k), _mm_loadu_pd (src+k)));
+    }
+#endif
+  for (; k < n; k++)
+    {
+      m_values[k] -= src[k];
+    }
+}
+
+void
+LoRaPowerVector::AddCompensated (const SpectrumValue &psd, LoRaPowerVector &error)
+{
+  uint32_t n;
+  const double *src = GetValues (psd, n);
+  for (uint32_t k = 0; k < n; k++)
+    {
+      double y = src[k] - error.m_values[k];
+      double t = m_values[k] + y;
+      error.m_values[k] = (t - m_values[k]) - y;
+      m_values[k] = t;
+    }
+}
+
+void
+LoRaPowerVector::SubtractCompensated (const SpectrumValue &psd, LoRaPowerVector &error)
+{
+  uint32_t n;
+  const double *src = GetValues (psd, n);
+  for (uint32_t k = 0; k < n; k++)
+    {
+      double y = -src[k] - error.m_values[k];
+      double t = m_values[k] + y;
+      error.m_values[k] = (t - m_values[k]) - y;
+      m_values[k] = t;
+    }
+}
+
+void
+LoRaPowerVector::Zero (void)
+{
+  for (uint32_t k = 0; k < PADDED; k++)
+    {
+      m_values[k] = 0.0;
+    }
+}
+
+double
+LoRaPowerVector::Sum (uint32_t first, uint32_t last) const
+{
+  NS_ASSERT (last <= BANDS);
+  double sum = 0.0;
+  uint32_t k = first;
+#if defined (__SSE2__)
+  __m128d acc = _mm_setzero_pd ();
+  for (; k+2 <= last; k += 2)
+    {
+      acc = _mm_add_pd (acc, _mm_loadu_pd (m_values+k));
+    }
+  double lanes[2];
+  _mm_storeu_pd (lanes, acc);
+  sum = lanes[0] + lanes[1];
+#endif
+  for (; k < last; k++)
+    {
+      sum += m_values[k];
+    }
+  return sum;
+}
+
+Ptr<SpectrumValue>
+LoRaPowerVector::ToSpectrumValue (Ptr<const SpectrumModel> model) const
+{
+  NS_ASSERT (model->GetNumBands () <= BANDS);
+  Ptr<SpectrumValue> value = Create<SpectrumValue> (model);
+  for (uint32_t k = 0; k < model->GetNumBands (); k++)
+    {
+      (*value)[k] = m_values[k];
+    }
+  return value;
+}
+
+} // namespace ns3
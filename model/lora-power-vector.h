@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_POWER_VECTOR_H
+#define LORA_POWER_VECTOR_H
+
+#include <ns3/spectrum-value.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lora
+ *
+ * Power per bin of the LoRa receiver grid (70 x 25 kHz from 868 MHz).
+ *
+ * The receiver keeps the sum of all incoming signals in this fixed size
+ * array instead of a SpectrumValue, so adding and removing a signal is a single
+ * vectorized pass without allocations or spectrum model checks. SpectrumValues are
+ * only read at the boundary, when a signal arrives from the channel.
+ *
+ * The kernels use AVX or SSE2 when the compiler targets them and plain loops otherwise.
+ * They use unaligned loads and stores and the array has no alignment requirement, so
+ * the vector can live in heap memory from a plain new (LoRaPhy allocates it lazily).
+ */
+class LoRaPowerVector
+{
+public:
+  static const uint32_t BANDS = 70; //!< bins of the LoRa receiver grid
+
+  LoRaPowerVector ();
+
+  /**
+   * Add a signal to every bin
+   *
+   * \param psd the signal, on a model with at most BANDS bins
+   */
+  void Add (const SpectrumValue &psd);
+
+  /**
+   * Subtract a signal from every bin
+   *
+   * \param psd the signal, on a model with at most BANDS bins
+   */
+  void Subtract (const SpectrumValue &psd);
+
+  /**
+   * Add a signal with Kahan summation
+   *
+   * \param psd the signal, on a model with at most BANDS bins
+   * \param error running compensation of this vector
+   */
+  void AddCompensated (const SpectrumValue &psd, LoRaPowerVector &error);
+
+  /**
+   * Subtract a signal with Kahan summation
+   *
+   * \param psd the signal, on a model with at most BANDS bins
+   * \param error running compensation of this vector
+   */
+  void SubtractCompensated (const SpectrumValue &psd, LoRaPowerVector &error);
+
+  /**
+   * Set every bin to zero
+   */
+  void Zero (void);
+
+  /**
+   * Get the sum of a range of bins
+   *
+   * \param first first bin
+   * \param last bins strictly below last are summed
+   * \return the summed power
+   */
+  double Sum (uint32_t first, uint32_t last) const;
+
+  /**
+   * \param k the bin
+   * \return the power in bin k
+   */
+  double operator[] (uint32_t k) const
+  {
+    return m_values[k];
+  }
+
+  /**
+   * Copy the power to a SpectrumValue
+   *
+   * \param model the spectrum model of the result, with at most BANDS bins
+   * \return the power on that model
+   */
+  Ptr<SpectrumValue> ToSpectrumValue (Ptr<const SpectrumModel> model) const;
+
+private:
+  static const uint32_t PADDED = 72; //!< BANDS rounded up to a multiple of the AVX width
+
+  /**
+   * Get the bins of a signal
+   *
+   * \param psd the signal
+   * \param n (out) the number of bins
+   * \return the first bin
+   */
+  static const double * GetValues (const SpectrumValue &psd, uint32_t &n);
+
+  double m_values[PADDED]; //!< power per bin, the padding stays zero
+};
+
+} // namespace ns3
+
+#endif /* LORA_POWER_VECTOR_H */
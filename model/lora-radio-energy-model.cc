@@ -80,6 +80,7 @@ LoRaRadioEnergyModel::LoRaRadioEnergyModel ()
   m_sourceEnergyUnlimited = 0;
   m_remainingBatteryEnergy = 0;
   m_sourcedepleted = 0;
+  m_extraCurrentA = 0;
 }
 
 LoRaRadioEnergyModel::~LoRaRadioEnergyModel ()
@@ -190,6 +191,7 @@ LoRaRadioEnergyModel::ChangeLoRaState (LoRaPhyState oldState, LoRaPhyState newSt
 				default:
           NS_FATAL_ERROR ("LoRaRadioEnergyModel:Undefined radio state: " << m_currentState);
         }
+      m_energyToDecrease += duration.GetSeconds () * m_extraCurrentA * supplyVoltage;
 
       // update total energy consumption
       m_totalEnergyConsumption += m_energyToDecrease;
@@ -213,6 +215,22 @@ LoRaRadioEnergyModel::ChangeLoRaState (LoRaPhyState oldState, LoRaPhyState newSt
 {
 }
 
+void
+LoRaRadioEnergyModel::ChargeSkippedRx (Time duration)
+{
+  NS_LOG_FUNCTION (this << duration);
+  // the source charges the current over the time since its last update, so the
+  // extra receive current of the window is spread over that interval
+  Time elapsed = Simulator::Now () - m_lastUpdateTime;
+  if (!elapsed.IsStrictlyPositive ())
+    {
+      return;
+    }
+  m_extraCurrentA = (m_RxCurrentA-m_IdleCurrentA)*duration.GetSeconds ()/elapsed.GetSeconds ();
+  ChangeLoRaState (m_currentState, m_currentState);
+  m_extraCurrentA = 0;
+}
+
 /*
  * Private functions start here.
  */
@@ -232,11 +250,11 @@ LoRaRadioEnergyModel::DoGetCurrentA (void) const
   switch (m_currentState)
     {
     case LoRaPhyState::LoRaIDLE:
-      return m_IdleCurrentA;
+      return m_IdleCurrentA+m_extraCurrentA;
     case LoRaPhyState::LoRaTX:
-      return m_TxCurrentA;
+      return m_TxCurrentA+m_extraCurrentA;
     case LoRaPhyState::LoRaRX:
-      return m_RxCurrentA;
+      return m_RxCurrentA+m_extraCurrentA;
     default:
       NS_FATAL_ERROR ("LoRaRadioEnergyModel:Undefined radio state:" << m_currentState);
     }
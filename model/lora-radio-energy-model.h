@@ -120,6 +120,12 @@ public:
    */
   void ChangeLoRaState (LoRaPhyState oldState, LoRaPhyState newState);
 
+  /**
+   * \brief Charge a receive window that the MAC skipped as if the receiver had been on
+   * \param duration length of the window
+   */
+  void ChargeSkippedRx (Time duration);
+
 private:
   /**
    * Implement real destruction code and chain up to the parent's implementation once done
@@ -158,6 +164,7 @@ private:
 	LoRaPhyState m_currentState;  // current state the radio is in
   Time m_lastUpdateTime;                // time stamp of previous energy update
   double m_energyToDecrease;            // consumed energy of lastest LoRaRadioEnergyMode
+  double m_extraCurrentA;               // current of skipped receive windows, spread over the last interval
   double m_remainingBatteryEnergy;      // remaining battery energy of the energy source attaching to the node
   bool m_sourceEnergyUnlimited;         // battery energy of the energy source attaching to the node unlimited or not
   bool m_sourcedepleted;                // battery energy of the energy source depleted or not
@@ -173,7 +173,7 @@ namespace ns3 {
 					beaconHeader.AddChannel(m_rssiValues[(i)%m_availableChannels],0x3f);
 			}
 			beacon->AddHeader(beaconHeader);
-			StartTransmission(beacon,frequencies[(minutes+m_offset)%m_availableChannels],3,1);
+			StartTransmission(beacon,m_plan->frequencies[(minutes+m_offset)%m_availableChannels],3,1);
 			m_beacon = Simulator::Schedule(m_interBeacon,&LoRaRsGwNetDevice::SendBeacon,this);
 		}
 
@@ -60,10 +60,7 @@ namespace ns3 {
 	{
 		NS_LOG_FUNCTION (this);
 		m_seqNum = m_random->GetInteger(0,60);
-		for (uint8_t index = 6; index < 16; index++){
-			channelAvailable[index] = false;
-			frequencies[index] = 0;
-		}
+		// the default plan already has no channels from index 6 on
 		m_interBeacon = Seconds(60);
 		m_rssiBeacon[0] = -150;
 		m_rssiBeacon[1] = -175;
@@ -116,12 +113,7 @@ namespace ns3 {
 			NS_LOG_LOGIC (this << " state=" << m_state);
 			Simulator::ScheduleNow(&LoRaNetDevice::TryAgain,this);
 			NS_LOG_LOGIC ("enqueueing new packet");
-			NS_ASSERT (m_queue);
-			if (m_queue->Enqueue (Create<QueueItem> (packet)) == false)
-			{
-				m_macTxDropTrace (packet);
-				sendOk = false;
-			}
+			sendOk = Enqueue (packet);
 			return sendOk;
 
 		}
@@ -172,7 +164,7 @@ namespace ns3 {
 			uint32_t minutes = Simulator::Now().GetMinutes();
 			m_state = BEACON;
 			Simulator::ScheduleNow(&LoRaPhy::SetBandwidth, m_phy, 125000);
-			Simulator::ScheduleNow(&LoRaPhy::SetChannelIndex, m_phy, frequencies[(m_offset+minutes)%3]);
+			Simulator::ScheduleNow(&LoRaPhy::SetChannelIndex, m_phy, m_plan->frequencies[(m_offset+minutes)%3]);
 			Simulator::ScheduleNow(&LoRaPhy::SetSpreadingFactor, m_phy, 9);
 			Simulator::ScheduleNow(&LoRaPhy::ChangeState, m_phy, LoRaPhyState::LoRaRX);
 			m_beaconTimeout = Simulator::Schedule(Seconds(0.4),&LoRaRsNetDevice::BeaconTimeout, this);
@@ -239,12 +231,11 @@ namespace ns3 {
 				}
 				if(m_currentPkt==0)
 				{
-					if (m_queue->IsEmpty () == false)
+					if (m_queue.IsEmpty () == false)
 					{
 						startTimePacket = Simulator::Now();
-						Ptr<QueueItem> item = m_queue->Dequeue ();
-						NS_ASSERT(item);
-						m_currentPkt = item->GetPacket ();
+						m_currentPkt = m_queue.Dequeue ();
+						NS_ASSERT(m_currentPkt);
 						LoRaMacHeader header2;
 						m_currentPkt->RemoveHeader(header2);
 						header2.SetFrmCounter(m_seqNum);
@@ -268,7 +259,7 @@ namespace ns3 {
 				else if(confirmed && GetFreeChannel()!=127)
 				{
 					for (uint8_t i = 0; i<16;i++){
-						if(datarate[i]>minDatarate[i] && (retransmissionCount == 3 || retransmissionCount == 5 || retransmissionCount == 7))
+						if(datarate[i]>m_plan->minDatarate[i] && (retransmissionCount == 3 || retransmissionCount == 5 || retransmissionCount == 7))
 						{
 							datarate[i]--;
 						}
@@ -287,7 +278,7 @@ namespace ns3 {
 				if (m_ackCnt > ADR_ACK_LIMIT)
 				{
 					for (uint8_t i = 0; i<16;i++){
-						if(datarate[i]>minDatarate[i])
+						if(datarate[i]>m_plan->minDatarate[i])
 						{
 							datarate[i]--;
 						}
@@ -325,7 +316,7 @@ namespace ns3 {
 				if (m_ackCnt > ADR_ACK_LIMIT)
 				{
 					for (uint8_t i = 0; i<16;i++){
-						if(datarate[i]>minDatarate[i])
+						if(datarate[i]>m_plan->minDatarate[i])
 						{
 							datarate[i]--;
 						}
@@ -523,7 +514,7 @@ namespace ns3 {
 		{
 			for(uint8_t i = 0; i<16; i++)
 			{
-				if (frequencies[i] == frequency)
+				if (m_plan->frequencies[i] == frequency)
 					return i;
 			}
 			return 255;
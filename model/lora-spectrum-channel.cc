@@ -0,0 +1,615 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-spectrum-channel.h"
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/spectrum-signal-parameters.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+#include <ns3/mobility-model.h>
+#include <ns3/net-device.h>
+#include <ns3/node.h>
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/uinteger.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/jakes-propagation-loss-model.h>
+#include <ns3/log.h>
+#include <ns3/trace-source-accessor.h>
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaSpectrumChannel);
+
+const int64_t LoRaSpectrumChannel::NO_CELL = std::numeric_limits<int64_t>::min ();
+
+TypeId
+LoRaSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaSpectrumChannel")
+    .SetParent<SpectrumChannel> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaSpectrumChannel> ()
+    .AddAttribute ("MaxLoss",
+                   "If a single-frequency PropagationLossModel is used, this value "
+                   "represents the maximum loss in dB for which transmissions will be "
+                   "passed to the receiving PHY.",
+                   DoubleValue (1.0e9),
+                   MakeDoubleAccessor (&LoRaSpectrumChannel::m_maxLossDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CacheLinkGain",
+                   "Remember the deterministic path loss between nodes with a ConstantPositionMobilityModel. "
+                   "Fading models (Nakagami, Jakes, random) are still sampled for every signal.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaSpectrumChannel::m_cacheLinkGain),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxCachedLinks",
+                   "The link gain cache is emptied when it holds this many links.",
+                   UintegerValue (1000000),
+                   MakeUintegerAccessor (&LoRaSpectrumChannel::m_maxCachedLinks),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CullingDistance",
+                   "Static receivers further than this horizontal distance (m) from a static transmitter do not "
+                   "get the signal at all. 0 delivers to all receivers. Set it before devices are attached.",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&LoRaSpectrumChannel::m_cullingDistance),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("CullingLoss",
+                   "The lowest loss (dB) of a receiver beyond CullingDistance. Only used to bound the culled power. "
+                   "A negative value uses the deterministic loss at CullingDistance, at the height of the transmitter.",
+                   DoubleValue (-1.0),
+                   MakeDoubleAccessor (&LoRaSpectrumChannel::m_cullingLoss),
+                   MakeDoubleChecker<double> ())
+    .AddTraceSource ("RxPathLoss",
+                     "The loss of every signal that is delivered to a receiver",
+                     MakeTraceSourceAccessor (&LoRaSpectrumChannel::m_pathLossTrace),
+                     "ns3::SpectrumChannel::LossTracedCallback")
+    .AddTraceSource ("Culled",
+                     "The power of a transmission that was not delivered to some receivers "
+                     "(the bound from CullingLoss for receivers out of CullingDistance)",
+                     MakeTraceSourceAccessor (&LoRaSpectrumChannel::m_culledTrace),
+                     "ns3::LoRaSpectrumChannel::CulledTracedCallback")
+  ;
+  return tid;
+}
+
+LoRaSpectrumChannel::LoRaSpectrumChannel ()
+{
+  NS_LOG_FUNCTION (this);
+  m_propagationLoss = 0;
+  m_fadingLoss = 0;
+  m_spectrumPropagationLoss = 0;
+  m_propagationDelay = 0;
+  m_maxLossDb = 1.0e9;
+  m_cacheLinkGain = true;
+  m_maxCachedLinks = 1000000;
+  m_cullingDistance = 0.0;
+  m_cullingLoss = -1.0;
+  m_culledSignals = 0;
+  m_culledPower = 0.0;
+  m_gridListeners = 0;
+}
+
+LoRaSpectrumChannel::~LoRaSpectrumChannel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaSpectrumChannel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_propagationLoss = 0;
+  m_fadingLoss = 0;
+  m_spectrumPropagationLoss = 0;
+  m_propagationDelay = 0;
+  m_linkGain.clear ();
+  m_phys.clear ();
+  m_listeners.clear ();
+  m_grid.clear ();
+  m_gridListeners = 0;
+  m_listenerIndex.clear ();
+  m_converters.clear ();
+  SpectrumChannel::DoDispose ();
+}
+
+void
+LoRaSpectrumChannel::AddPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT (m_propagationLoss == 0 && m_fadingLoss == 0);
+  SplitPropagationLoss (loss, m_propagationLoss, m_fadingLoss);
+  m_cullingLossByHeight.clear ();
+}
+
+void
+LoRaSpectrumChannel::SplitPropagationLoss (Ptr<PropagationLossModel> loss,
+                                           Ptr<PropagationLossModel> &deterministicLoss,
+                                           Ptr<PropagationLossModel> &fadingLoss)
+{
+  // split the chain in a deterministic part, which can be cached per link, and the fading part
+  std::vector<Ptr<PropagationLossModel> > deterministic;
+  std::vector<Ptr<PropagationLossModel> > fading;
+  for (Ptr<PropagationLossModel> model = loss; model != 0; model = model->GetNext ())
+    {
+      if (DynamicCast<NakagamiPropagationLossModel> (model) != 0
+          || DynamicCast<JakesPropagationLossModel> (model) != 0
+          || DynamicCast<RandomPropagationLossModel> (model) != 0)
+        {
+          fading.push_back (model);
+        }
+      else
+        {
+          deterministic.push_back (model);
+        }
+    }
+  for (uint32_t i = 0; i < deterministic.size (); i++)
+    {
+      deterministic[i]->SetNext (i+1 < deterministic.size () ? deterministic[i+1] : Ptr<PropagationLossModel> ());
+    }
+  for (uint32_t i = 0; i < fading.size (); i++)
+    {
+      fading[i]->SetNext (i+1 < fading.size () ? fading[i+1] : Ptr<PropagationLossModel> ());
+    }
+  deterministicLoss = deterministic.empty () ? 0 : deterministic.front ();
+  fadingLoss = fading.empty () ? 0 : fading.front ();
+}
+
+double
+LoRaSpectrumChannel::GetLinkGain (Ptr<MobilityModel> txMobility, Ptr<MobilityModel> rxMobility)
+{
+  double gainDb = 0;
+  if (m_propagationLoss)
+    {
+      if (m_cacheLinkGain
+          && DynamicCast<ConstantPositionMobilityModel> (txMobility) != 0
+          && DynamicCast<ConstantPositionMobilityModel> (rxMobility) != 0)
+        {
+          std::pair<MobilityModel*,MobilityModel*> key = std::make_pair (PeekPointer (txMobility), PeekPointer (rxMobility));
+          std::map<std::pair<MobilityModel*,MobilityModel*>, double>::iterator it = m_linkGain.find (key);
+          if (it != m_linkGain.end ())
+            {
+              gainDb = it->second;
+            }
+          else
+            {
+              if (m_linkGain.size () >= m_maxCachedLinks)
+                {
+                  m_linkGain.clear ();
+                }
+              WatchMobility (txMobility);
+              WatchMobility (rxMobility);
+              gainDb = m_propagationLoss->CalcRxPower (0, txMobility, rxMobility);
+              m_linkGain[key] = gainDb;
+            }
+        }
+      else
+        {
+          gainDb = m_propagationLoss->CalcRxPower (0, txMobility, rxMobility);
+        }
+    }
+  if (m_fadingLoss)
+    {
+      gainDb = m_fadingLoss->CalcRxPower (gainDb, txMobility, rxMobility);
+    }
+  return gainDb;
+}
+
+void
+LoRaSpectrumChannel::WatchMobility (Ptr<MobilityModel> mobility)
+{
+  if (m_watched.insert (PeekPointer (mobility)).second)
+    {
+      mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&LoRaSpectrumChannel::CourseChanged, this));
+    }
+}
+
+void
+LoRaSpectrumChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+  // forget all links of the node that moved
+  const MobilityModel *moved = PeekPointer (mobility);
+  std::map<std::pair<MobilityModel*,MobilityModel*>, double>::iterator it = m_linkGain.begin ();
+  while (it != m_linkGain.end ())
+    {
+      if (it->first.first == moved || it->first.second == moved)
+        {
+          m_linkGain.erase (it++);
+        }
+      else
+        {
+          it++;
+        }
+    }
+  // a static listener that moved has to change cell
+  std::vector<Ptr<SpectrumPhy> > moving;
+  for (std::map<int64_t, std::vector<Ptr<SpectrumPhy> > >::iterator cell = m_grid.begin (); cell != m_grid.end (); cell++)
+    {
+      for (std::vector<Ptr<SpectrumPhy> >::iterator phy = cell->second.begin (); phy != cell->second.end (); phy++)
+        {
+          if (PeekPointer ((*phy)->GetMobility ()) == moved)
+            {
+              moving.push_back (*phy);
+            }
+        }
+    }
+  for (std::vector<Ptr<SpectrumPhy> >::iterator phy = moving.begin (); phy != moving.end (); phy++)
+    {
+      Unsubscribe (*phy);
+      Subscribe (*phy);
+    }
+}
+
+void
+LoRaSpectrumChannel::AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT (m_spectrumPropagationLoss == 0);
+  m_spectrumPropagationLoss = loss;
+}
+
+void
+LoRaSpectrumChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  NS_ASSERT (m_propagationDelay == 0);
+  m_propagationDelay = delay;
+}
+
+Ptr<SpectrumPropagationLossModel>
+LoRaSpectrumChannel::GetSpectrumPropagationLossModel (void)
+{
+  NS_LOG_FUNCTION (this);
+  return m_spectrumPropagationLoss;
+}
+
+void
+LoRaSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  AddDevice (phy);
+  Subscribe (phy);
+}
+
+void
+LoRaSpectrumChannel::AddDevice (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  for (std::vector<Ptr<SpectrumPhy> >::iterator it = m_phys.begin (); it != m_phys.end (); it++)
+    {
+      if (*it == phy)
+        return;
+    }
+  m_phys.push_back (phy);
+}
+
+void
+LoRaSpectrumChannel::RemoveRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  Unsubscribe (phy);
+  for (std::vector<Ptr<SpectrumPhy> >::iterator it = m_phys.begin (); it != m_phys.end (); it++)
+    {
+      if (*it == phy)
+        {
+          m_phys.erase (it);
+          return;
+        }
+    }
+}
+
+int64_t
+LoRaSpectrumChannel::GetCellKey (int32_t x, int32_t y)
+{
+  return ((int64_t) x << 32) | (uint32_t) y;
+}
+
+int64_t
+LoRaSpectrumChannel::GetCell (Ptr<SpectrumPhy> phy) const
+{
+  if (m_cullingDistance <= 0)
+    return NO_CELL;
+  Ptr<MobilityModel> mobility = phy->GetMobility ();
+  if (DynamicCast<ConstantPositionMobilityModel> (mobility) == 0)
+    return NO_CELL;
+  Vector position = mobility->GetPosition ();
+  return GetCellKey (std::floor (position.x / m_cullingDistance), std::floor (position.y / m_cullingDistance));
+}
+
+std::vector<Ptr<SpectrumPhy> > &
+LoRaSpectrumChannel::GetListeners (int64_t cell)
+{
+  if (cell == NO_CELL)
+    return m_listeners;
+  return m_grid[cell];
+}
+
+void
+LoRaSpectrumChannel::Subscribe (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  if (m_listenerIndex.find (PeekPointer (phy)) != m_listenerIndex.end ())
+    return;
+  int64_t cell = GetCell (phy);
+  if (cell != NO_CELL)
+    {
+      // follow the node in case it is moved with SetPosition
+      WatchMobility (phy->GetMobility ());
+      m_gridListeners++;
+    }
+  std::vector<Ptr<SpectrumPhy> > &listeners = GetListeners (cell);
+  m_listenerIndex[PeekPointer (phy)] = std::make_pair (cell, listeners.size ());
+  listeners.push_back (phy);
+}
+
+void
+LoRaSpectrumChannel::Unsubscribe (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  std::map<SpectrumPhy*, std::pair<int64_t,uint32_t> >::iterator it = m_listenerIndex.find (PeekPointer (phy));
+  if (it == m_listenerIndex.end ())
+    return;
+  int64_t cell = it->second.first;
+  uint32_t index = it->second.second;
+  m_listenerIndex.erase (it);
+  if (cell != NO_CELL)
+    m_gridListeners--;
+  // move the last listener of the cell in the free slot
+  std::vector<Ptr<SpectrumPhy> > &listeners = GetListeners (cell);
+  if (index != listeners.size () - 1)
+    {
+      listeners[index] = listeners.back ();
+      m_listenerIndex[PeekPointer (listeners[index])].second = index;
+    }
+  listeners.pop_back ();
+}
+
+uint32_t
+LoRaSpectrumChannel::GetNListeners (void) const
+{
+  return m_listeners.size () + m_gridListeners;
+}
+
+uint64_t
+LoRaSpectrumChannel::GetCulledSignals (void) const
+{
+  return m_culledSignals;
+}
+
+double
+LoRaSpectrumChannel::GetCulledPower (void) const
+{
+  return m_culledPower;
+}
+
+double
+LoRaSpectrumChannel::GetDistanceForLoss (double lossDb, double txHeight, double rxHeight)
+{
+  NS_LOG_FUNCTION (this << lossDb << txHeight << rxHeight);
+  if (m_propagationLoss == 0)
+    return std::numeric_limits<double>::infinity ();
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (0, 0, txHeight));
+  // bisection between 1 m and 1000 km
+  double low = 1;
+  double high = 1e6;
+  for (uint32_t i = 0; i < 60; i++)
+    {
+      double middle = std::sqrt (low*high);
+      b->SetPosition (Vector (middle, 0, rxHeight));
+      if (-m_propagationLoss->CalcRxPower (0, a, b) < lossDb)
+        low = middle;
+      else
+        high = middle;
+    }
+  return high;
+}
+
+double
+LoRaSpectrumChannel::GetCullingLoss (double height)
+{
+  if (m_cullingLoss >= 0)
+    return m_cullingLoss;
+  std::map<double, double>::const_iterator it = m_cullingLossByHeight.find (height);
+  if (it != m_cullingLossByHeight.end ())
+    return it->second;
+  double lossDb = 0.0;
+  if (m_propagationLoss != 0)
+    {
+      Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+      Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+      a->SetPosition (Vector (0, 0, height));
+      b->SetPosition (Vector (m_cullingDistance, 0, height));
+      lossDb = std::max (0.0, -m_propagationLoss->CalcRxPower (0, a, b));
+    }
+  NS_LOG_LOGIC ("culling loss at height " << height << ": " << lossDb << " dB");
+  m_cullingLossByHeight[height] = lossDb;
+  return lossDb;
+}
+
+std::size_t
+LoRaSpectrumChannel::GetNDevices (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_phys.size ();
+}
+
+Ptr<NetDevice>
+LoRaSpectrumChannel::GetDevice (std::size_t i) const
+{
+  NS_LOG_FUNCTION (this << i);
+  return m_phys.at (i)->GetDevice ()->GetObject<NetDevice> ();
+}
+
+Ptr<SpectrumSignalParameters>
+LoRaSpectrumChannel::GetRxParams (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  Ptr<SpectrumSignalParameters> rxParams = params->Copy ();
+  // convert the PSD to the model of the receiver, converters are built once per pair of models
+  Ptr<const SpectrumModel> rxModel = receiver->GetRxSpectrumModel ();
+  Ptr<const SpectrumModel> txModel = params->psd->GetSpectrumModel ();
+  if (rxModel != 0 && rxModel->GetUid () != txModel->GetUid ())
+    {
+      std::pair<SpectrumModelUid_t,SpectrumModelUid_t> key = std::make_pair (txModel->GetUid (), rxModel->GetUid ());
+      std::map<std::pair<SpectrumModelUid_t,SpectrumModelUid_t>, SpectrumConverter>::iterator conv = m_converters.find (key);
+      if (conv == m_converters.end ())
+        {
+          NS_LOG_LOGIC ("new converter " << txModel->GetUid () << " -> " << rxModel->GetUid ());
+          conv = m_converters.insert (std::make_pair (key, SpectrumConverter (txModel, rxModel))).first;
+        }
+      rxParams->psd = conv->second.Convert (params->psd);
+    }
+  Ptr<MobilityModel> txMobility = params->txPhy->GetMobility ();
+  Ptr<MobilityModel> rxMobility = receiver->GetMobility ();
+  if (txMobility && rxMobility)
+    {
+      double gainDb = 0;
+      if (rxParams->txAntenna != 0)
+        {
+          Angles txAngles (rxMobility->GetPosition (), txMobility->GetPosition ());
+          gainDb += rxParams->txAntenna->GetGainDb (txAngles);
+        }
+      Ptr<AntennaModel> rxAntenna = receiver->GetRxAntenna ();
+      if (rxAntenna != 0)
+        {
+          Angles rxAngles (txMobility->GetPosition (), rxMobility->GetPosition ());
+          gainDb += rxAntenna->GetGainDb (rxAngles);
+        }
+      gainDb += GetLinkGain (txMobility, rxMobility);
+      m_pathLossTrace (params->txPhy, receiver, -gainDb);
+      if (-gainDb > m_maxLossDb)
+        {
+          double power = Integral (*params->psd) * std::pow (10.0, gainDb / 10.0);
+          m_culledSignals++;
+          m_culledPower += power;
+          m_culledTrace (params->txPhy, power);
+          return 0;
+        }
+      *(rxParams->psd) *= std::pow (10.0, gainDb / 10.0);
+      if (m_spectrumPropagationLoss)
+        {
+          rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, txMobility, rxMobility);
+        }
+    }
+  return rxParams;
+}
+
+void
+LoRaSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params->psd << params->duration << params->txPhy);
+  NS_ASSERT_MSG (params->psd, "NULL txPsd");
+  NS_ASSERT_MSG (params->txPhy, "NULL txPhy");
+  Ptr<MobilityModel> txMobility = params->txPhy->GetMobility ();
+  for (std::vector<Ptr<SpectrumPhy> >::const_iterator it = m_listeners.begin (); it != m_listeners.end (); it++)
+    {
+      Deliver (params, *it, txMobility);
+    }
+  if (m_gridListeners == 0)
+    return;
+  int64_t txCell = GetCell (params->txPhy);
+  if (txCell == NO_CELL)
+    {
+      // the transmitter moves, so it can not be located in the grid
+      for (std::map<int64_t, std::vector<Ptr<SpectrumPhy> > >::iterator cell = m_grid.begin (); cell != m_grid.end (); cell++)
+        {
+          for (std::vector<Ptr<SpectrumPhy> >::const_iterator it = cell->second.begin (); it != cell->second.end (); it++)
+            {
+              Deliver (params, *it, txMobility);
+            }
+        }
+      return;
+    }
+  // only the 3x3 cells around the transmitter can be within the culling distance
+  Vector txPosition = txMobility->GetPosition ();
+  int32_t x = std::floor (txPosition.x / m_cullingDistance);
+  int32_t y = std::floor (txPosition.y / m_cullingDistance);
+  uint32_t culled = m_gridListeners;
+  for (int32_t dx = -1; dx <= 1; dx++)
+    {
+      for (int32_t dy = -1; dy <= 1; dy++)
+        {
+          std::map<int64_t, std::vector<Ptr<SpectrumPhy> > >::iterator cell = m_grid.find (GetCellKey (x+dx, y+dy));
+          if (cell == m_grid.end ())
+            continue;
+          for (std::vector<Ptr<SpectrumPhy> >::const_iterator it = cell->second.begin (); it != cell->second.end (); it++)
+            {
+              Vector rxPosition = (*it)->GetMobility ()->GetPosition ();
+              double distance = std::sqrt ((rxPosition.x-txPosition.x)*(rxPosition.x-txPosition.x)+(rxPosition.y-txPosition.y)*(rxPosition.y-txPosition.y));
+              // the transmitter is not culled, it just does not hear itself
+              if (distance <= m_cullingDistance || *it == params->txPhy)
+                {
+                  culled--;
+                  Deliver (params, *it, txMobility);
+                }
+            }
+        }
+    }
+  if (culled > 0)
+    {
+      double power = culled * Integral (*params->psd) * std::pow (10.0, -GetCullingLoss (txPosition.z) / 10.0);
+      m_culledSignals += culled;
+      m_culledPower += power;
+      m_culledTrace (params->txPhy, power);
+    }
+}
+
+void
+LoRaSpectrumChannel::Deliver (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver, Ptr<MobilityModel> txMobility)
+{
+  if (receiver == params->txPhy)
+    return;
+  Ptr<SpectrumSignalParameters> rxParams = GetRxParams (params, receiver);
+  if (rxParams == 0)
+    return;
+  Time delay = MicroSeconds (0);
+  Ptr<MobilityModel> rxMobility = receiver->GetMobility ();
+  if (m_propagationDelay && txMobility && rxMobility)
+    {
+      delay = m_propagationDelay->GetDelay (txMobility, rxMobility);
+    }
+  Ptr<NetDevice> netDev = receiver->GetDevice () != 0 ? receiver->GetDevice ()->GetObject<NetDevice> () : 0;
+  if (netDev != 0 && netDev->GetNode () != 0)
+    {
+      Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), delay, &LoRaSpectrumChannel::StartRx, this, rxParams, receiver);
+    }
+  else
+    {
+      Simulator::Schedule (delay, &LoRaSpectrumChannel::StartRx, this, rxParams, receiver);
+    }
+}
+
+void
+LoRaSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  NS_LOG_FUNCTION (this << params);
+  receiver->StartRx (params);
+}
+
+} // namespace ns3
@@ -0,0 +1,281 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_SPECTRUM_CHANNEL_H
+#define LORA_SPECTRUM_CHANNEL_H
+
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-converter.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/spectrum-propagation-loss-model.h>
+#include <ns3/traced-callback.h>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace ns3 {
+
+class SpectrumPhy;
+class NetDevice;
+class MobilityModel;
+struct SpectrumSignalParameters;
+
+/**
+ * \ingroup lora
+ *
+ * SpectrumChannel for LoRa networks that only delivers a transmission to the
+ * receivers that are listening at that moment.
+ *
+ * Phys attached with AddRx are always listening (gateways, other spectrum phys).
+ * Phys attached with AddDevice only receive while they are subscribed, which
+ * LoRaPhy does when it enters and leaves LoRaRX. Class A devices are idle most of
+ * the time, so the propagation work per transmission scales with the number of
+ * gateways plus the devices that have a receive window open.
+ */
+class LoRaSpectrumChannel : public SpectrumChannel
+{
+  friend class LoRaSubBandSpectrumChannel;
+
+public:
+  /**
+   * TracedCallback signature for power that is not delivered.
+   *
+   * \param [in] txPhy the transmitting phy
+   * \param [in] power the power in W that is not delivered
+   */
+  typedef void (* CulledTracedCallback) (Ptr<const SpectrumPhy> txPhy, double power);
+
+  LoRaSpectrumChannel ();
+  virtual ~LoRaSpectrumChannel ();
+
+  static TypeId GetTypeId (void);
+
+  // inherited from SpectrumChannel
+  virtual void AddPropagationLossModel (Ptr<PropagationLossModel> loss);
+  virtual void AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss);
+  virtual void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+  virtual Ptr<SpectrumPropagationLossModel> GetSpectrumPropagationLossModel (void);
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+  virtual void AddRx (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Split a propagation loss chain in its deterministic models and its fading models
+   * (Nakagami, Jakes, random), each relinked into a chain of its own.
+   *
+   * \param loss the first model of the chain
+   * \param deterministicLoss set to the chain that can be cached per link, or 0
+   * \param fadingLoss set to the chain that is sampled for every signal, or 0
+   */
+  static void SplitPropagationLoss (Ptr<PropagationLossModel> loss,
+                                    Ptr<PropagationLossModel> &deterministicLoss,
+                                    Ptr<PropagationLossModel> &fadingLoss);
+
+  /**
+   * Detach a phy from the channel completely.
+   *
+   * \param phy the phy to remove
+   */
+  virtual void RemoveRx (Ptr<SpectrumPhy> phy);
+
+  // inherited from Channel
+  virtual std::size_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+  /**
+   * Attach a phy that only receives while it is subscribed.
+   *
+   * \param phy the phy to attach
+   */
+  virtual void AddDevice (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Start delivering transmissions to a phy attached with AddDevice.
+   *
+   * \param phy the phy that starts listening
+   */
+  virtual void Subscribe (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Stop delivering transmissions to a phy attached with AddDevice.
+   * Signals that are already on their way are still delivered.
+   *
+   * \param phy the phy that stops listening
+   */
+  virtual void Unsubscribe (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Get the number of phys transmissions are currently delivered to.
+   *
+   * \return the number of listening phys
+   */
+  virtual uint32_t GetNListeners (void) const;
+
+  /**
+   * Get the number of signals that were not delivered because the receiver was
+   * further than CullingDistance or the loss was higher than MaxLoss.
+   *
+   * \return the number of signals that were not delivered
+   */
+  virtual uint64_t GetCulledSignals (void) const;
+
+  /**
+   * Get the total power that was not delivered to receivers.
+   * Signals dropped by MaxLoss count with their actual power, signals culled by
+   * distance with the bound given by CullingLoss. By default that bound is the
+   * deterministic loss at CullingDistance.
+   *
+   * \return the total power in W
+   */
+  virtual double GetCulledPower (void) const;
+
+  /**
+   * Get the distance at which the deterministic loss models reach a given loss,
+   * e.g. the maximal transmit power minus the SF12 sensitivity. The loss is assumed
+   * to increase with distance. This can be used to set CullingDistance.
+   *
+   * \param lossDb the loss in dB
+   * \param txHeight height of the transmitter
+   * \param rxHeight height of the receiver
+   * \return the distance in m
+   */
+  double GetDistanceForLoss (double lossDb, double txHeight, double rxHeight);
+
+protected:
+  virtual void DoDispose (void);
+
+  /**
+   * Deliver a signal to a receiver. This is meant to be scheduled.
+   *
+   * \param params the signal as seen by the receiver
+   * \param receiver the phy that receives the signal
+   */
+  void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Get the signal as seen by a receiver: PSD converted to its spectrum model,
+   * with the antenna gains and the propagation loss applied.
+   *
+   * \param params the transmitted signal
+   * \param receiver the receiving phy
+   * \return the received signal, or 0 if the receiver does not receive it
+   */
+  virtual Ptr<SpectrumSignalParameters> GetRxParams (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Get the gain of the propagation loss models between two nodes.
+   * The deterministic part is cached for static nodes, the fading part is sampled every time.
+   *
+   * \param txMobility position of the transmitter
+   * \param rxMobility position of the receiver
+   * \return the gain in dB
+   */
+  double GetLinkGain (Ptr<MobilityModel> txMobility, Ptr<MobilityModel> rxMobility);
+
+  /**
+   * Get the lowest loss of a receiver beyond CullingDistance: CullingLoss, or the
+   * deterministic loss at CullingDistance when CullingLoss is negative.
+   *
+   * \param height height of the transmitter, also used for the receiver
+   * \return the loss in dB
+   */
+  double GetCullingLoss (double height);
+
+  Ptr<PropagationLossModel> m_propagationLoss; //!< deterministic loss of the channel
+  Ptr<PropagationLossModel> m_fadingLoss; //!< stochastic loss of the channel, sampled for every signal
+  Ptr<SpectrumPropagationLossModel> m_spectrumPropagationLoss; //!< frequency dependent loss of the channel
+  Ptr<PropagationDelayModel> m_propagationDelay; //!< delay of the channel
+  double m_maxLossDb; //!< signals with a higher loss are not delivered
+  bool m_cacheLinkGain; //!< cache the deterministic loss between static nodes
+  uint32_t m_maxCachedLinks; //!< maximal size of the link gain cache
+
+  TracedCallback<Ptr<const SpectrumPhy>, Ptr<const SpectrumPhy>, double > m_pathLossTrace; //!< loss of every delivered signal
+  TracedCallback<Ptr<const SpectrumPhy>, double > m_culledTrace; //!< power of a transmission that was not delivered
+
+  double m_cullingDistance; //!< receivers further away do not get the signal, 0 to disable
+  double m_cullingLoss; //!< lowest loss of a receiver beyond m_cullingDistance, negative to derive it
+  std::map<double, double> m_cullingLossByHeight; //!< derived culling loss per transmitter height
+  uint64_t m_culledSignals; //!< number of signals that were not delivered
+  double m_culledPower; //!< total power that was not delivered
+
+private:
+  /**
+   * Deliver a transmission to one receiver after the propagation delay
+   *
+   * \param params the transmitted signal
+   * \param receiver the receiving phy
+   * \param txMobility position of the transmitter
+   */
+  void Deliver (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver, Ptr<MobilityModel> txMobility);
+
+  /**
+   * Get the grid cell of a static phy
+   *
+   * \param phy the phy to place in the grid
+   * \return the cell, or the key of the list of phys outside the grid
+   */
+  int64_t GetCell (Ptr<SpectrumPhy> phy) const;
+
+  /**
+   * Get the key of a grid cell
+   *
+   * \param x index of the cell along x
+   * \param y index of the cell along y
+   * \return the key of the cell
+   */
+  static int64_t GetCellKey (int32_t x, int32_t y);
+
+  /**
+   * Get the listeners of a cell
+   *
+   * \param cell key of the cell
+   * \return the listeners in the cell
+   */
+  std::vector<Ptr<SpectrumPhy> > & GetListeners (int64_t cell);
+
+  /**
+   * Start listening to the course changes of a mobility model, once.
+   *
+   * \param mobility the mobility model of a node with cached links
+   */
+  void WatchMobility (Ptr<MobilityModel> mobility);
+
+  /**
+   * Remove all cached links of a node that moved and move it in the grid.
+   *
+   * \param mobility the mobility model that changed
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+
+  static const int64_t NO_CELL; //!< key of m_listeners
+
+  std::map<std::pair<MobilityModel*,MobilityModel*>, double> m_linkGain; //!< cached deterministic gain per (tx, rx)
+  std::set<MobilityModel*> m_watched; //!< mobility models whose course changes are followed
+  std::vector<Ptr<SpectrumPhy> > m_phys; //!< all attached phys
+  std::vector<Ptr<SpectrumPhy> > m_listeners; //!< listening phys outside the grid (moving or without position), always delivered to
+  std::map<int64_t, std::vector<Ptr<SpectrumPhy> > > m_grid; //!< listening static phys per cell of CullingDistance
+  uint32_t m_gridListeners; //!< number of phys in m_grid
+  std::map<SpectrumPhy*, std::pair<int64_t,uint32_t> > m_listenerIndex; //!< cell and position of every listener
+  std::map<std::pair<SpectrumModelUid_t,SpectrumModelUid_t>, SpectrumConverter> m_converters; //!< converters between tx and rx models
+};
+
+} // namespace ns3
+
+#endif /* LORA_SPECTRUM_CHANNEL_H */
@@ -100,6 +100,27 @@ LoRaSpectrumSignalParameters::GetBer ()
   return m_ber;
 }
 
+void
+LoRaSpectrumSignalParameters::AddSinrSegment (double duration, double sinr)
+{
+  if (duration <= 0)
+    return;
+  if (!m_segments.empty () && m_segments.back ().second == sinr)
+    {
+      m_segments.back ().first += duration;
+    }
+  else
+    {
+      m_segments.push_back (std::make_pair (duration, sinr));
+    }
+}
+
+const std::vector<std::pair<double,double> > &
+LoRaSpectrumSignalParameters::GetSinrSegments ()
+{
+  return m_segments;
+}
+
 void 
 LoRaSpectrumSignalParameters::SetSpreading (uint16_t spreading)
 {
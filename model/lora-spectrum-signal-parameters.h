@@ -24,6 +24,7 @@
 
 #include <ns3/spectrum-signal-parameters.h>
 #include <ns3/packet.h>
+#include <vector>
 namespace ns3 {
 
 
@@ -111,6 +112,22 @@ namespace ns3 {
 			 */
 			void SetBer (uint32_t ber); 
 
+			/**
+			 * Close a piece of the reception during which the SINR was constant.
+			 * Consecutive pieces with the same SINR are merged.
+			 *
+			 * \param duration length of the piece in seconds
+			 * \param sinr the signal to noise and interference ratio during this piece (not in dB)
+			 */
+			void AddSinrSegment (double duration, double sinr);
+
+			/**
+			 * Getter for the SINR timeline of this reception
+			 *
+			 * \return the list of (duration, sinr) pieces received so far
+			 */
+			const std::vector<std::pair<double,double> > & GetSinrSegments ();
+
 		private:
 			// settings needed for receiver 
 			// This is possible because GW can receive multiple signals at once.
@@ -118,6 +135,7 @@ namespace ns3 {
 			uint32_t m_bandwidth; //!< the bandwidth of this signal
 			uint16_t m_spreading; //!< the spreading factor of this signal
 			uint32_t m_ber; //!< the number of wrong bit in this packet
+			std::vector<std::pair<double,double> > m_segments; //!< (duration, sinr) pieces of this reception
 	};
 
 }  // namespace ns3
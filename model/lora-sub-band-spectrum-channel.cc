@@ -0,0 +1,304 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-sub-band-spectrum-channel.h"
+#include "lora-phy.h"
+#include "lora-gw-phy.h"
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/spectrum-signal-parameters.h>
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaSubBandSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaSubBandSpectrumChannel);
+
+TypeId
+LoRaSubBandSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaSubBandSpectrumChannel")
+    .SetParent<LoRaSpectrumChannel> ()
+    .SetGroupName ("LoRa")
+    .AddConstructor<LoRaSubBandSpectrumChannel> ()
+  ;
+  return tid;
+}
+
+LoRaSubBandSpectrumChannel::LoRaSubBandSpectrumChannel ()
+{
+  NS_LOG_FUNCTION (this);
+  m_wideband = 0;
+}
+
+LoRaSubBandSpectrumChannel::~LoRaSubBandSpectrumChannel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaSubBandSpectrumChannel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::vector<Ptr<LoRaSpectrumChannel> >::iterator it = m_subChannels.begin (); it != m_subChannels.end (); it++)
+    {
+      (*it)->Dispose ();
+    }
+  m_subChannels.clear ();
+  if (m_wideband != 0)
+    {
+      m_wideband->Dispose ();
+      m_wideband = 0;
+    }
+  m_subscriptions.clear ();
+  LoRaSpectrumChannel::DoDispose ();
+}
+
+void
+LoRaSubBandSpectrumChannel::AddSubBand (double low, double high)
+{
+  NS_LOG_FUNCTION (this << low << high);
+  NS_ASSERT_MSG (m_wideband == 0, "sub-bands must be added before phys are attached");
+  NS_ASSERT (low < high);
+  m_bands.push_back (std::make_pair (low, high));
+}
+
+void
+LoRaSubBandSpectrumChannel::AddDefaultSubBands (void)
+{
+  NS_LOG_FUNCTION (this);
+  AddSubBand (868.0e6, 868.6e6);
+  AddSubBand (868.7e6, 869.2e6);
+  AddSubBand (869.4e6, 869.65e6);
+}
+
+uint32_t
+LoRaSubBandSpectrumChannel::GetNSubBands (void) const
+{
+  return m_bands.size ();
+}
+
+void
+LoRaSubBandSpectrumChannel::Partition (void)
+{
+  if (m_wideband != 0)
+    return;
+  NS_LOG_FUNCTION (this);
+  if (m_bands.empty ())
+    {
+      AddDefaultSubBands ();
+    }
+  m_wideband = CreateObject<LoRaSpectrumChannel> ();
+  CopyModels (m_wideband);
+  for (uint32_t i = 0; i < m_bands.size (); i++)
+    {
+      Ptr<LoRaSpectrumChannel> channel = CreateObject<LoRaSpectrumChannel> ();
+      CopyModels (channel);
+      m_subChannels.push_back (channel);
+    }
+}
+
+void
+LoRaSubBandSpectrumChannel::CopyModels (Ptr<LoRaSpectrumChannel> channel)
+{
+  // the loss chain is already split by this channel, so it is shared as is
+  channel->m_propagationLoss = m_propagationLoss;
+  channel->m_fadingLoss = m_fadingLoss;
+  channel->m_spectrumPropagationLoss = m_spectrumPropagationLoss;
+  channel->m_propagationDelay = m_propagationDelay;
+  channel->m_cullingDistance = m_cullingDistance;
+  CopySettings (channel);
+  channel->TraceConnectWithoutContext ("RxPathLoss", MakeCallback (&LoRaSubBandSpectrumChannel::NotifyPathLoss, this));
+  channel->TraceConnectWithoutContext ("Culled", MakeCallback (&LoRaSubBandSpectrumChannel::NotifyCulled, this));
+}
+
+void
+LoRaSubBandSpectrumChannel::CopySettings (Ptr<LoRaSpectrumChannel> channel)
+{
+  channel->m_maxLossDb = m_maxLossDb;
+  channel->m_cacheLinkGain = m_cacheLinkGain;
+  channel->m_maxCachedLinks = m_maxCachedLinks;
+  channel->m_cullingLoss = m_cullingLoss;
+}
+
+void
+LoRaSubBandSpectrumChannel::AddPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT_MSG (m_wideband == 0, "models must be added before phys are attached");
+  LoRaSpectrumChannel::AddPropagationLossModel (loss);
+}
+
+void
+LoRaSubBandSpectrumChannel::AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT_MSG (m_wideband == 0, "models must be added before phys are attached");
+  LoRaSpectrumChannel::AddSpectrumPropagationLossModel (loss);
+}
+
+void
+LoRaSubBandSpectrumChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  NS_ASSERT_MSG (m_wideband == 0, "models must be added before phys are attached");
+  LoRaSpectrumChannel::SetPropagationDelayModel (delay);
+}
+
+Ptr<LoRaSpectrumChannel>
+LoRaSubBandSpectrumChannel::GetSubChannel (Ptr<SpectrumPhy> phy)
+{
+  Ptr<LoRaPhy> loraPhy = DynamicCast<LoRaPhy> (phy);
+  if (loraPhy == 0 || DynamicCast<LoRaGwPhy> (phy) != 0)
+    return m_wideband;
+  double low = loraPhy->GetChannelIndex ()*100.0 - loraPhy->GetBandwidth ()/2.0;
+  double high = loraPhy->GetChannelIndex ()*100.0 + loraPhy->GetBandwidth ()/2.0;
+  for (uint32_t i = 0; i < m_bands.size (); i++)
+    {
+      if (low >= m_bands[i].first && high <= m_bands[i].second)
+        return m_subChannels[i];
+    }
+  return m_wideband;
+}
+
+void
+LoRaSubBandSpectrumChannel::AddDevice (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  Partition ();
+  LoRaSpectrumChannel::AddDevice (phy);
+}
+
+void
+LoRaSubBandSpectrumChannel::RemoveRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  LoRaSpectrumChannel::RemoveRx (phy);
+  if (m_wideband == 0)
+    return;
+  m_wideband->RemoveRx (phy);
+  for (std::vector<Ptr<LoRaSpectrumChannel> >::iterator it = m_subChannels.begin (); it != m_subChannels.end (); it++)
+    {
+      (*it)->RemoveRx (phy);
+    }
+}
+
+void
+LoRaSubBandSpectrumChannel::Subscribe (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  Partition ();
+  if (m_subscriptions.find (PeekPointer (phy)) != m_subscriptions.end ())
+    return;
+  Ptr<LoRaSpectrumChannel> channel = GetSubChannel (phy);
+  channel->AddDevice (phy);
+  channel->Subscribe (phy);
+  m_subscriptions[PeekPointer (phy)] = channel;
+}
+
+void
+LoRaSubBandSpectrumChannel::Unsubscribe (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  std::map<SpectrumPhy*, Ptr<LoRaSpectrumChannel> >::iterator it = m_subscriptions.find (PeekPointer (phy));
+  if (it == m_subscriptions.end ())
+    return;
+  it->second->Unsubscribe (phy);
+  m_subscriptions.erase (it);
+}
+
+uint32_t
+LoRaSubBandSpectrumChannel::GetNListeners (void) const
+{
+  return m_subscriptions.size ();
+}
+
+uint64_t
+LoRaSubBandSpectrumChannel::GetCulledSignals (void) const
+{
+  uint64_t culled = m_wideband != 0 ? m_wideband->GetCulledSignals () : 0;
+  for (std::vector<Ptr<LoRaSpectrumChannel> >::const_iterator it = m_subChannels.begin (); it != m_subChannels.end (); it++)
+    {
+      culled += (*it)->GetCulledSignals ();
+    }
+  return culled;
+}
+
+double
+LoRaSubBandSpectrumChannel::GetCulledPower (void) const
+{
+  double culled = m_wideband != 0 ? m_wideband->GetCulledPower () : 0;
+  for (std::vector<Ptr<LoRaSpectrumChannel> >::const_iterator it = m_subChannels.begin (); it != m_subChannels.end (); it++)
+    {
+      culled += (*it)->GetCulledPower ();
+    }
+  return culled;
+}
+
+void
+LoRaSubBandSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params->psd << params->duration << params->txPhy);
+  NS_ASSERT_MSG (params->psd, "NULL txPsd");
+  Partition ();
+  // the occupied band is the part of the psd that is not zero
+  double low = 0;
+  double high = 0;
+  bool occupied = false;
+  Values::const_iterator value = params->psd->ConstValuesBegin ();
+  for (Bands::const_iterator band = params->psd->ConstBandsBegin (); band != params->psd->ConstBandsEnd (); band++, value++)
+    {
+      if (*value > 0)
+        {
+          if (!occupied)
+            low = band->fl;
+          high = band->fh;
+          occupied = true;
+        }
+    }
+  if (!occupied)
+    return;
+  // attributes may have changed since the sub-channels were created
+  CopySettings (m_wideband);
+  m_wideband->StartTx (params);
+  for (uint32_t i = 0; i < m_bands.size (); i++)
+    {
+      if (high > m_bands[i].first && low < m_bands[i].second)
+        {
+          CopySettings (m_subChannels[i]);
+          m_subChannels[i]->StartTx (params);
+        }
+    }
+}
+
+void
+LoRaSubBandSpectrumChannel::NotifyPathLoss (Ptr<const SpectrumPhy> txPhy, Ptr<const SpectrumPhy> rxPhy, double lossDb)
+{
+  m_pathLossTrace (txPhy, rxPhy, lossDb);
+}
+
+void
+LoRaSubBandSpectrumChannel::NotifyCulled (Ptr<const SpectrumPhy> txPhy, double power)
+{
+  m_culledTrace (txPhy, power);
+}
+
+} // namespace ns3
@@ -0,0 +1,140 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_SUB_BAND_SPECTRUM_CHANNEL_H
+#define LORA_SUB_BAND_SPECTRUM_CHANNEL_H
+
+#include <ns3/lora-spectrum-channel.h>
+#include <vector>
+#include <map>
+
+namespace ns3 {
+
+/**
+ * \ingroup lora
+ *
+ * LoRaSpectrumChannel that is split in a LoRaSpectrumChannel per sub-band.
+ *
+ * A transmission is only handed to the sub-channels whose band overlaps with the
+ * non-zero part of its power spectral density, so a downlink on 869.525 MHz is never
+ * propagated to or converted for devices listening on 868.1 MHz. A LoRaPhy listens on
+ * the sub-channel that contains its channel and bandwidth, and moves when its channel
+ * index changes. Gateways, phys that span several sub-bands and other spectrum phys
+ * are attached to a wideband sub-channel that gets every transmission.
+ *
+ * The propagation models, attributes and traces are set on this object and shared
+ * with the sub-channels, which are created when the first phy is attached. The models
+ * and CullingDistance are fixed from then on; MaxLoss, CacheLinkGain, MaxCachedLinks
+ * and CullingLoss are forwarded at every transmission. Without sub-bands, the default
+ * EU868 sub-bands are used.
+ */
+class LoRaSubBandSpectrumChannel : public LoRaSpectrumChannel
+{
+public:
+  LoRaSubBandSpectrumChannel ();
+  virtual ~LoRaSubBandSpectrumChannel ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Add a sub-band. Sub-bands should not overlap and must be added before
+   * any phy is attached.
+   *
+   * \param low lowest frequency of the sub-band in Hz
+   * \param high highest frequency of the sub-band in Hz
+   */
+  void AddSubBand (double low, double high);
+
+  /**
+   * Add the sub-bands of the EU868 band plan that fall in the LoRa receiver grid
+   * (868.0-869.75 MHz): 868.0-868.6 MHz, 868.7-869.2 MHz and 869.4-869.65 MHz.
+   */
+  void AddDefaultSubBands (void);
+
+  /**
+   * \return the number of sub-bands
+   */
+  uint32_t GetNSubBands (void) const;
+
+  // inherited from SpectrumChannel
+  virtual void AddPropagationLossModel (Ptr<PropagationLossModel> loss);
+  virtual void AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss);
+  virtual void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+  virtual void RemoveRx (Ptr<SpectrumPhy> phy);
+
+  // inherited from LoRaSpectrumChannel
+  virtual void AddDevice (Ptr<SpectrumPhy> phy);
+  virtual void Subscribe (Ptr<SpectrumPhy> phy);
+  virtual void Unsubscribe (Ptr<SpectrumPhy> phy);
+  virtual uint32_t GetNListeners (void) const;
+  virtual uint64_t GetCulledSignals (void) const;
+  virtual double GetCulledPower (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * Create the sub-channels, once.
+   */
+  void Partition (void);
+
+  /**
+   * Give a sub-channel the same models and settings as this channel.
+   *
+   * \param channel the sub-channel
+   */
+  void CopyModels (Ptr<LoRaSpectrumChannel> channel);
+
+  /**
+   * Give a sub-channel the attributes of this channel that can change after it was created.
+   *
+   * \param channel the sub-channel
+   */
+  void CopySettings (Ptr<LoRaSpectrumChannel> channel);
+
+  /**
+   * Get the sub-channel a phy listens on.
+   *
+   * \param phy the listening phy
+   * \return the sub-channel of its band, or the wideband sub-channel
+   */
+  Ptr<LoRaSpectrumChannel> GetSubChannel (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Forward the path loss trace of a sub-channel.
+   */
+  void NotifyPathLoss (Ptr<const SpectrumPhy> txPhy, Ptr<const SpectrumPhy> rxPhy, double lossDb);
+
+  /**
+   * Forward the culled trace of a sub-channel.
+   */
+  void NotifyCulled (Ptr<const SpectrumPhy> txPhy, double power);
+
+  std::vector<std::pair<double,double> > m_bands; //!< low and high frequency of every sub-band
+  std::vector<Ptr<LoRaSpectrumChannel> > m_subChannels; //!< channel per sub-band
+  Ptr<LoRaSpectrumChannel> m_wideband; //!< channel for phys that listen to more than one sub-band
+  std::map<SpectrumPhy*, Ptr<LoRaSpectrumChannel> > m_subscriptions; //!< sub-channel of every listening phy
+};
+
+} // namespace ns3
+
+#endif /* LORA_SUB_BAND_SPECTRUM_CHANNEL_H */
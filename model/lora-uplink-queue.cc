@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include "lora-uplink-queue.h"
+#include <ns3/log.h>
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaUplinkQueue");
+
+LoRaUplinkQueue::LoRaUplinkQueue ()
+{
+  m_items = m_inline;
+  m_capacity = INLINE_PACKETS;
+  m_head = 0;
+  m_size = 0;
+  m_maxPackets = 100;
+  m_dropPolicy = DROP_TAIL;
+}
+
+LoRaUplinkQueue::~LoRaUplinkQueue ()
+{
+  Clear ();
+}
+
+void
+LoRaUplinkQueue::SetMaxPackets (uint32_t maxPackets)
+{
+  // packets above a lower maximum stay, only new packets are refused
+  m_maxPackets = maxPackets;
+}
+
+uint32_t
+LoRaUplinkQueue::GetMaxPackets (void) const
+{
+  return m_maxPackets;
+}
+
+void
+LoRaUplinkQueue::SetDropPolicy (DropPolicy policy)
+{
+  m_dropPolicy = policy;
+}
+
+LoRaUplinkQueue::DropPolicy
+LoRaUplinkQueue::GetDropPolicy (void) const
+{
+  return m_dropPolicy;
+}
+
+Ptr<Packet>
+LoRaUplinkQueue::Enqueue (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  Ptr<Packet> dropped = 0;
+  if (m_size >= m_maxPackets)
+    {
+      if (m_dropPolicy == DROP_TAIL || m_size == 0)
+        {
+          return packet;
+        }
+      dropped = Dequeue ();
+    }
+  if (m_size == m_capacity)
+    {
+      Grow ();
+    }
+  m_items[(m_head+m_size)%m_capacity] = packet;
+  m_size++;
+  return dropped;
+}
+
+Ptr<Packet>
+LoRaUplinkQueue::Dequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_size == 0)
+    {
+      return 0;
+    }
+  Ptr<Packet> packet = m_items[m_head];
+  m_items[m_head] = 0;
+  m_head = (m_head+1)%m_capacity;
+  m_size--;
+  if (m_size == 0)
+    {
+      m_head = 0;
+      if (m_items != m_inline)
+        {
+          delete [] m_items;
+          m_items = m_inline;
+          m_capacity = INLINE_PACKETS;
+        }
+    }
+  return packet;
+}
+
+bool
+LoRaUplinkQueue::IsEmpty (void) const
+{
+  return m_size == 0;
+}
+
+uint32_t
+LoRaUplinkQueue::GetNPackets (void) const
+{
+  return m_size;
+}
+
+void
+LoRaUplinkQueue::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  while (m_size > 0)
+    {
+      Dequeue ();
+    }
+}
+
+void
+LoRaUplinkQueue::Grow (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t capacity = std::max (m_size+1, std::min (2*m_capacity, m_maxPackets));
+  Ptr<Packet> *items = new Ptr<Packet>[capacity];
+  for (uint32_t i = 0; i < m_size; i++)
+    {
+      items[i] = m_items[(m_head+i)%m_capacity];
+      m_items[(m_head+i)%m_capacity] = 0;
+    }
+  if (m_items != m_inline)
+    {
+      delete [] m_items;
+    }
+  m_items = items;
+  m_capacity = capacity;
+  m_head = 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#ifndef LORA_UPLINK_QUEUE_H
+#define LORA_UPLINK_QUEUE_H
+
+#include <ns3/packet.h>
+#include <ns3/ptr.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lora
+ *
+ * Queue of the uplink packets of an end device, kept inside the device.
+ *
+ * The first INLINE_PACKETS packets are stored in the queue itself. Longer queues
+ * move to a ring on the heap that grows up to the maximum size, and the queue
+ * returns to the inline storage once it is empty again. A full queue drops either
+ * the new packet (DROP_TAIL) or the oldest one (DROP_OLDEST).
+ */
+class LoRaUplinkQueue
+{
+public:
+  /**
+   * What to drop when the queue is full
+   */
+  enum DropPolicy
+  {
+    DROP_TAIL, //!< drop the new packet
+    DROP_OLDEST //!< drop the oldest packet, the freshest data wins
+  };
+
+  static const uint32_t INLINE_PACKETS = 2; //!< packets stored without a heap allocation
+
+  LoRaUplinkQueue ();
+  ~LoRaUplinkQueue ();
+
+  /**
+   * \param maxPackets the maximum number of packets in the queue
+   */
+  void SetMaxPackets (uint32_t maxPackets);
+
+  /**
+   * \return the maximum number of packets in the queue
+   */
+  uint32_t GetMaxPackets (void) const;
+
+  /**
+   * \param policy what to drop when the queue is full
+   */
+  void SetDropPolicy (DropPolicy policy);
+
+  /**
+   * \return what is dropped when the queue is full
+   */
+  DropPolicy GetDropPolicy (void) const;
+
+  /**
+   * Add a packet at the end of the queue.
+   *
+   * \param packet the packet
+   * \return the dropped packet: the given one or the oldest one, 0 if nothing was dropped
+   */
+  Ptr<Packet> Enqueue (Ptr<Packet> packet);
+
+  /**
+   * Remove the packet at the head of the queue.
+   *
+   * \return the packet, 0 if the queue is empty
+   */
+  Ptr<Packet> Dequeue (void);
+
+  /**
+   * \return true if the queue holds no packet
+   */
+  bool IsEmpty (void) const;
+
+  /**
+   * \return the number of packets in the queue
+   */
+  uint32_t GetNPackets (void) const;
+
+  /**
+   * Remove all packets.
+   */
+  void Clear (void);
+
+private:
+  /**
+   * Copy constructor - defined and not implemented.
+   */
+  LoRaUplinkQueue (const LoRaUplinkQueue &);
+
+  /**
+   * Assignment operator - defined and not implemented.
+   * \returns
+   */
+  LoRaUplinkQueue &operator= (const LoRaUplinkQueue &);
+
+  /**
+   * Move the packets to a ring twice as large, at most the maximum size.
+   */
+  void Grow (void);
+
+  Ptr<Packet> m_inline[INLINE_PACKETS]; //!< storage of short queues
+  Ptr<Packet> *m_items; //!< the ring, m_inline or an array on the heap
+  uint32_t m_capacity; //!< size of the ring
+  uint32_t m_head; //!< position of the oldest packet in the ring
+  uint32_t m_size; //!< packets in the queue
+  uint32_t m_maxPackets; //!< maximum number of packets
+  DropPolicy m_dropPolicy; //!< what to drop when the queue is full
+};
+
+} // namespace ns3
+
+#endif /* LORA_UPLINK_QUEUE_H */
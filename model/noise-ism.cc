@@ -19,6 +19,7 @@
  */
 
 #include "noise-ism.h"
+#include "lora-phy.h"
 #include <ns3/spectrum-phy.h>
 #include <ns3/log.h>
 #include <ns3/spectrum-model.h>
@@ -31,6 +32,7 @@
 #include "ns3/string.h"
 #include <ns3/net-device.h>
 #include "ns3/mobility-model.h"
+#include <algorithm>
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("NoiseIsm");
@@ -144,25 +146,22 @@ NoiseIsm::CreateTxPowerSpectralDensity (void)
 	while (bandwidth <= 0)
 		bandwidth = m_bandwidth->GetInteger();
   double txPowerDensity = 0.025/bandwidth;
-  double channelwidth = bandwidth/4;
   double channeloffset =0;
 	while (channeloffset <= 0)
 		channeloffset = m_centerFrequency->GetValue();
-  //and fill it
-  Bands bands;
-  for (uint32_t i= 0; i < 4 ;i++){
-		BandInfo bi;
-		bi.fl = channeloffset+i*channelwidth-bandwidth/2;
- 		bi.fh = channeloffset+(i+1)*channelwidth-bandwidth/2;
-		bi.fc = (bi.fl+bi.fh)/2;
-		bands.push_back (bi);
-  }
-  Ptr<SpectrumModel> sm = Create<SpectrumModel> (bands);
-  Ptr<SpectrumValue> test = Create<SpectrumValue> (sm);
-  for (uint32_t i= 0; i < 4;i++){
-		(*test)[i]=txPowerDensity;
+  // Express the burst directly on the shared LoRa receiver grid. Receivers only see these bands anyway,
+  // so this gives the same result as the spectrum converter without a new model per burst.
+  Ptr<const SpectrumModel> sm = LoRaPhy::GetDefaultRxSpectrumModel ();
+  Ptr<SpectrumValue> psd = Create<SpectrumValue> (sm);
+  double fl = channeloffset-bandwidth/2;
+  double fh = channeloffset+bandwidth/2;
+  uint32_t i = 0;
+  for (Bands::const_iterator it = sm->Begin (); it != sm->End (); it++, i++){
+		double overlap = std::min (fh, it->fh)-std::max (fl, it->fl);
+		if (overlap > 0)
+			(*psd)[i]=txPowerDensity*overlap/(it->fh-it->fl);
 	}
-  return test->Copy ();
+  return psd;
 }
 
 Ptr<const SpectrumModel>
@@ -0,0 +1,164 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include <ns3/test.h>
+#include <ns3/boolean.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/lora-error-model.h>
+#include <cmath>
+
+using namespace ns3;
+
+/**
+ * \ingroup lora
+ *
+ * The number of bit errors drawn from one uniform sample must follow B(bits,ber).
+ */
+class LoRaBitErrorsTestCase : public TestCase
+{
+public:
+  LoRaBitErrorsTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaBitErrorsTestCase::LoRaBitErrorsTestCase ()
+  : TestCase ("Check the mean and variance of the bit error draws")
+{
+}
+
+void
+LoRaBitErrorsTestCase::DoRun (void)
+{
+  Ptr<LoRaErrorModel> model = CreateObject<LoRaErrorModel> ();
+  Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+  uniform->SetStream (1);
+
+  NS_TEST_EXPECT_MSG_EQ (model->GetBitErrors (0, 160, 0.5), 0, "no errors without a BER");
+  NS_TEST_EXPECT_MSG_EQ (model->GetBitErrors (1, 160, 0.5), 160, "every bit is wrong at a BER of 1");
+  NS_TEST_EXPECT_MSG_EQ (model->GetBitErrors (0.1, 0, 0.5), 0, "no errors in an empty block");
+
+  static const double cases[5][2] = {{1e-4, 2000}, {1e-3, 160}, {0.01, 400}, {0.2, 160}, {0.5, 64}};
+  const uint32_t draws = 20000;
+  for (uint32_t c = 0; c < 5; c++)
+    {
+      double ber = cases[c][0];
+      uint32_t bits = cases[c][1];
+      double sum = 0.0;
+      double squares = 0.0;
+      for (uint32_t i = 0; i < draws; i++)
+        {
+          double errors = model->GetBitErrors (ber, bits, uniform->GetValue ());
+          sum += errors;
+          squares += errors*errors;
+        }
+      double mean = sum/draws;
+      double variance = squares/draws-mean*mean;
+      double expectedMean = bits*ber;
+      double expectedVariance = expectedMean*(1-ber);
+      // five standard errors of the estimates
+      NS_TEST_EXPECT_MSG_EQ_TOL (mean, expectedMean, 5*std::sqrt (expectedVariance/draws),
+                                 "mean of B(" << bits << "," << ber << ")");
+      NS_TEST_EXPECT_MSG_EQ_TOL (variance, expectedVariance, 5*std::sqrt ((expectedVariance+2*expectedVariance*expectedVariance)/draws),
+                                 "variance of B(" << bits << "," << ber << ")");
+    }
+}
+
+/**
+ * \ingroup lora
+ *
+ * The BER tables must stay within the documented relative error of the model.
+ */
+class LoRaBerTableTestCase : public TestCase
+{
+public:
+  LoRaBerTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaBerTableTestCase::LoRaBerTableTestCase ()
+  : TestCase ("Compare the BER tables with the model")
+{
+}
+
+void
+LoRaBerTableTestCase::DoRun (void)
+{
+  Ptr<LoRaErrorModel> table = CreateObject<LoRaErrorModel> ();
+  table->SetAttribute ("LookupTable", BooleanValue (true));
+  Ptr<LoRaErrorModel> exact = CreateObject<LoRaErrorModel> ();
+  exact->SetAttribute ("LookupTable", BooleanValue (false));
+  static const int bandwidths[3] = {125000, 250000, 500000};
+  for (uint16_t sf = 7; sf <= 12; sf++)
+    {
+      for (uint32_t b = 0; b < 3; b++)
+        {
+          double worst = 0.0;
+          double worstDb = 0.0;
+          // a step off the 0.01 dB grid, so most SNRs are interpolated
+          for (double snrDb = -35.0; snrDb < 35.0; snrDb += 0.0037)
+            {
+              double snr = std::pow (10.0, snrDb/10);
+              long double reference = exact->GetBER (snr, sf, bandwidths[b]);
+              long double ber = table->GetBER (snr, sf, bandwidths[b]);
+              if (reference >= 1)
+                {
+                  NS_TEST_EXPECT_MSG_EQ (ber == 1, true, "SF" << sf << " " << bandwidths[b] << " at " << snrDb << " dB");
+                  continue;
+                }
+              if (reference <= 1e-300L)
+                {
+                  NS_TEST_EXPECT_MSG_EQ (ber < 1e-290L, true, "SF" << sf << " " << bandwidths[b] << " at " << snrDb << " dB");
+                  continue;
+                }
+              double error = std::fabs ((double) ((ber-reference)/reference));
+              if (error > worst)
+                {
+                  worst = error;
+                  worstDb = snrDb;
+                }
+            }
+          NS_TEST_EXPECT_MSG_LT (worst, 5e-4, "SF" << sf << " " << bandwidths[b] << " worst at " << worstDb << " dB");
+        }
+    }
+}
+
+/**
+ * \ingroup lora
+ *
+ * Tests of the LoRa error model
+ */
+class LoRaErrorModelTestSuite : public TestSuite
+{
+public:
+  LoRaErrorModelTestSuite ();
+};
+
+LoRaErrorModelTestSuite::LoRaErrorModelTestSuite ()
+  : TestSuite ("lora-error-model", UNIT)
+{
+  AddTestCase (new LoRaBitErrorsTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaBerTableTestCase, TestCase::QUICK);
+}
+
+static LoRaErrorModelTestSuite g_loRaErrorModelTestSuite; //!< the test suite
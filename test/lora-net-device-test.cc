@@ -0,0 +1,447 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/node-container.h>
+#include <ns3/mobility-helper.h>
+#include <ns3/position-allocator.h>
+#include <ns3/lora-helper.h>
+#include <ns3/lora-net-device.h>
+#include <ns3/lora-channel-plan.h>
+#include <ns3/lora-uplink-queue.h>
+#include <ns3/uinteger.h>
+#include <ns3/enum.h>
+#include <vector>
+#include <ns3/rng-seed-manager.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup lora
+ *
+ * A device with more uplinks than the regulations allow must stay within the
+ * duty cycle of every sub-band at all times.
+ */
+class LoRaDutyCycleTestCase : public TestCase
+{
+public:
+  LoRaDutyCycleTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Send an uplink of 10 bytes.
+   *
+   * \param device the end device
+   */
+  static void SendUplink (Ptr<NetDevice> device);
+
+  /**
+   * Check the measured duty cycle of every sub-band.
+   *
+   * \param device the end device
+   */
+  void CheckDutyCycle (Ptr<LoRaNetDevice> device);
+};
+
+LoRaDutyCycleTestCase::LoRaDutyCycleTestCase ()
+  : TestCase ("Keep a saturated device within the sub-band duty cycles")
+{
+}
+
+void
+LoRaDutyCycleTestCase::SendUplink (Ptr<NetDevice> device)
+{
+  device->Send (Create<Packet> (10), device->GetBroadcast (), 0);
+}
+
+void
+LoRaDutyCycleTestCase::CheckDutyCycle (Ptr<LoRaNetDevice> device)
+{
+  // limits of ETSI EN 300 220 per sub-band
+  static const double limits[LoRaNetDevice::SUB_BANDS] = {0.01, 0.01, 0.001, 0.1, 0.01, 1.0};
+  for (uint32_t band = 0; band < LoRaNetDevice::SUB_BANDS; band++)
+    {
+      NS_TEST_EXPECT_MSG_LT (device->GetSubBandDutyCycle ((LoRaNetDevice::SubBand) band), limits[band]+1e-9,
+                             "sub-band " << band << " at " << Simulator::Now ().GetSeconds () << " s");
+    }
+}
+
+void
+LoRaDutyCycleTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer gateways;
+  gateways.Create (1);
+  NodeContainer devices;
+  devices.Create (1);
+
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 0));
+  positions->Add (Vector (100, 0, 0));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gateways);
+  mobility.Install (devices);
+
+  LoRaHelper helper;
+  helper.InstallGateways (gateways);
+  NetDeviceContainer netDevices = helper.Install (devices);
+  Ptr<LoRaNetDevice> device = DynamicCast<LoRaNetDevice> (netDevices.Get (0));
+  NS_TEST_ASSERT_MSG_NE (device, 0, "the helper installs LoRaNetDevices");
+
+  // an uplink every second is far more than 1% of the time on air allows
+  for (uint32_t s = 1; s < 600; s++)
+    {
+      Simulator::Schedule (Seconds (s), &LoRaDutyCycleTestCase::SendUplink, netDevices.Get (0));
+    }
+  for (uint32_t s = 10; s <= 600; s += 10)
+    {
+      Simulator::Schedule (Seconds (s)+MilliSeconds (500), &LoRaDutyCycleTestCase::CheckDutyCycle, this, device);
+    }
+  Simulator::Stop (Seconds (601));
+  Simulator::Run ();
+
+  double total = 0.0;
+  for (uint32_t band = 0; band < LoRaNetDevice::SUB_BANDS; band++)
+    {
+      total += device->GetSubBandDutyCycle ((LoRaNetDevice::SubBand) band);
+    }
+  NS_TEST_EXPECT_MSG_GT (total, 0.0, "the device transmitted");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * Devices share the default channel plan until one of them changes its channels.
+ */
+class LoRaChannelPlanTestCase : public TestCase
+{
+public:
+  LoRaChannelPlanTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaChannelPlanTestCase::LoRaChannelPlanTestCase ()
+  : TestCase ("Copy the shared channel plan on the first change of a device")
+{
+}
+
+void
+LoRaChannelPlanTestCase::DoRun (void)
+{
+  Ptr<LoRaChannelPlan> defaultPlan = LoRaChannelPlan::GetDefault ();
+  Ptr<LoRaNetDevice> first = CreateObject<LoRaNetDevice> ();
+  Ptr<LoRaNetDevice> second = CreateObject<LoRaNetDevice> ();
+  NS_TEST_EXPECT_MSG_EQ (first->GetChannelPlan (), defaultPlan, "a new device uses the default plan");
+  NS_TEST_EXPECT_MSG_EQ (second->GetChannelPlan (), defaultPlan, "a new device uses the default plan");
+
+  NS_TEST_EXPECT_MSG_EQ (first->AddChannel (3, 8671000), true, "channel 3 is added");
+  Ptr<const LoRaChannelPlan> plan = first->GetChannelPlan ();
+  NS_TEST_EXPECT_MSG_NE (plan, defaultPlan, "the first change copies the plan");
+  NS_TEST_EXPECT_MSG_EQ (plan->available[3], true, "the device uses its new channel");
+  NS_TEST_EXPECT_MSG_EQ (plan->frequencies[3], 8671000u, "the device uses its new channel");
+  NS_TEST_EXPECT_MSG_EQ (second->GetChannelPlan (), defaultPlan, "the other device keeps the default plan");
+  NS_TEST_EXPECT_MSG_EQ (defaultPlan->available[3], false, "the default plan is unchanged");
+  NS_TEST_EXPECT_MSG_EQ (defaultPlan->frequencies[3], 8681000u, "the default plan is unchanged");
+  for (uint8_t i = 0; i < 3; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (plan->frequencies[i], defaultPlan->frequencies[i], "the copy keeps the default channel " << (uint32_t) i);
+      NS_TEST_EXPECT_MSG_EQ (plan->available[i], true, "the copy keeps the default channel " << (uint32_t) i);
+    }
+
+  // the plan is no longer shared, so further changes are made in place
+  first->RemoveChannel (0);
+  NS_TEST_EXPECT_MSG_EQ (first->GetChannelPlan (), plan, "a private plan is not copied again");
+  NS_TEST_EXPECT_MSG_EQ (plan->available[0], false, "channel 0 is removed");
+  NS_TEST_EXPECT_MSG_EQ (defaultPlan->available[0], true, "the default plan is unchanged");
+
+  // a plan given to several devices is shared again
+  Ptr<LoRaChannelPlan> common = LoRaChannelPlan::GetDefault ()->Copy ();
+  first->SetChannelPlan (common);
+  second->SetChannelPlan (common);
+  NS_TEST_EXPECT_MSG_EQ (second->SetChannelMask (0x8000), true, "the mask enables channel 0 only");
+  NS_TEST_EXPECT_MSG_NE (second->GetChannelPlan (), common, "the mask copies the shared plan");
+  NS_TEST_EXPECT_MSG_EQ (second->GetChannelPlan ()->available[1], false, "channel 1 is masked");
+  NS_TEST_EXPECT_MSG_EQ (first->GetChannelPlan (), common, "the other device keeps the shared plan");
+  NS_TEST_EXPECT_MSG_EQ (common->available[1], true, "the shared plan is unchanged");
+
+  first->Dispose ();
+  second->Dispose ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * The uplink queue keeps its order while it wraps and grows, and drops the new
+ * or the oldest packet when it is full.
+ */
+class LoRaUplinkQueueTestCase : public TestCase
+{
+public:
+  LoRaUplinkQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Remove the packets of the queue and compare them with the expected ones.
+   *
+   * \param queue the queue
+   * \param packets the expected packets, oldest first
+   */
+  void CheckOrder (LoRaUplinkQueue &queue, std::vector<Ptr<Packet> > packets);
+};
+
+LoRaUplinkQueueTestCase::LoRaUplinkQueueTestCase ()
+  : TestCase ("Keep the order of the uplink queue and drop the right packet when full")
+{
+}
+
+void
+LoRaUplinkQueueTestCase::CheckOrder (LoRaUplinkQueue &queue, std::vector<Ptr<Packet> > packets)
+{
+  NS_TEST_EXPECT_MSG_EQ (queue.GetNPackets (), packets.size (), "packets in the queue");
+  for (uint32_t i = 0; i < packets.size (); i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (queue.Dequeue (), packets[i], "packet " << i << " of the queue");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue.IsEmpty (), true, "the queue is empty");
+  NS_TEST_EXPECT_MSG_EQ (queue.Dequeue (), 0, "an empty queue returns no packet");
+}
+
+void
+LoRaUplinkQueueTestCase::DoRun (void)
+{
+  std::vector<Ptr<Packet> > packets;
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      packets.push_back (Create<Packet> (10));
+    }
+
+  LoRaUplinkQueue queue;
+  queue.SetMaxPackets (5);
+  NS_TEST_EXPECT_MSG_EQ (queue.GetDropPolicy (), LoRaUplinkQueue::DROP_TAIL, "packets are tail dropped by default");
+
+  // wrap around the inline storage
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[0]), 0, "no packet is dropped");
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[1]), 0, "no packet is dropped");
+  NS_TEST_EXPECT_MSG_EQ (queue.Dequeue (), packets[0], "the oldest packet leaves first");
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[2]), 0, "no packet is dropped");
+
+  // grow from the wrapped inline storage to the heap, and once more up to the maximum
+  for (uint32_t i = 3; i < 6; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[i]), 0, "no packet is dropped");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[6]), packets[6], "a full queue drops the new packet");
+  NS_TEST_EXPECT_MSG_EQ (queue.GetNPackets (), 5, "a full queue keeps its packets");
+
+  // wrap around the ring on the heap
+  NS_TEST_EXPECT_MSG_EQ (queue.Dequeue (), packets[1], "the oldest packet leaves first");
+  NS_TEST_EXPECT_MSG_EQ (queue.Dequeue (), packets[2], "the oldest packet leaves first");
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[7]), 0, "no packet is dropped");
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[8]), 0, "no packet is dropped");
+  std::vector<Ptr<Packet> > expected;
+  expected.push_back (packets[3]);
+  expected.push_back (packets[4]);
+  expected.push_back (packets[5]);
+  expected.push_back (packets[7]);
+  expected.push_back (packets[8]);
+  CheckOrder (queue, expected);
+
+  // the freshest packets win
+  queue.SetMaxPackets (3);
+  queue.SetDropPolicy (LoRaUplinkQueue::DROP_OLDEST);
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[i]), 0, "no packet is dropped");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[3]), packets[0], "a full queue drops the oldest packet");
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[4]), packets[1], "a full queue drops the oldest packet");
+  expected.clear ();
+  expected.push_back (packets[2]);
+  expected.push_back (packets[3]);
+  expected.push_back (packets[4]);
+  CheckOrder (queue, expected);
+
+  // without room there is no oldest packet to drop
+  queue.SetMaxPackets (0);
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (packets[9]), packets[9], "a queue without room drops the new packet");
+  NS_TEST_EXPECT_MSG_EQ (queue.IsEmpty (), true, "the queue is empty");
+}
+
+/**
+ * \ingroup lora
+ *
+ * An end device reports every packet its uplink queue drops.
+ */
+class LoRaMacTxDropTestCase : public TestCase
+{
+public:
+  LoRaMacTxDropTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Remember a dropped packet.
+   *
+   * \param packet the packet
+   */
+  void MacTxDrop (Ptr<const Packet> packet);
+
+  std::vector<uint64_t> m_dropped; //!< uids of the dropped packets
+};
+
+LoRaMacTxDropTestCase::LoRaMacTxDropTestCase ()
+  : TestCase ("Report the packets dropped by the uplink queue")
+{
+}
+
+void
+LoRaMacTxDropTestCase::MacTxDrop (Ptr<const Packet> packet)
+{
+  m_dropped.push_back (packet->GetUid ());
+}
+
+void
+LoRaMacTxDropTestCase::DoRun (void)
+{
+  Ptr<LoRaNetDevice> device = CreateObject<LoRaNetDevice> ();
+  device->TraceConnectWithoutContext ("MacTxDrop", MakeCallback (&LoRaMacTxDropTestCase::MacTxDrop, this));
+  device->SetAttribute ("MaxPackets", UintegerValue (2));
+
+  // nothing is sent before the simulation runs, so every packet waits in the queue
+  std::vector<Ptr<Packet> > packets;
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      packets.push_back (Create<Packet> (10));
+    }
+  NS_TEST_EXPECT_MSG_EQ (device->Send (packets[0], device->GetBroadcast (), 0), true, "the packet is queued");
+  NS_TEST_EXPECT_MSG_EQ (device->Send (packets[1], device->GetBroadcast (), 0), true, "the packet is queued");
+  NS_TEST_EXPECT_MSG_EQ (device->Send (packets[2], device->GetBroadcast (), 0), false, "a full queue refuses the packet");
+  NS_TEST_EXPECT_MSG_EQ (m_dropped.size (), 1, "the refused packet is reported");
+  NS_TEST_EXPECT_MSG_EQ (m_dropped.back (), packets[2]->GetUid (), "the refused packet is reported");
+
+  device->SetAttribute ("DropPolicy", EnumValue (LoRaUplinkQueue::DROP_OLDEST));
+  NS_TEST_EXPECT_MSG_EQ (device->Send (packets[3], device->GetBroadcast (), 0), true, "the packet is queued");
+  NS_TEST_EXPECT_MSG_EQ (m_dropped.size (), 2, "the oldest packet is reported");
+  NS_TEST_EXPECT_MSG_EQ (m_dropped.back (), packets[0]->GetUid (), "the oldest packet is reported");
+
+  device->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * The downlink announcements of the gateways are forgotten once no receive
+ * window can reach them, also when no device uses lazy receive windows.
+ */
+class LoRaDownlinkRegistryTestCase : public TestCase
+{
+public:
+  LoRaDownlinkRegistryTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Announce a downlink to a new device now.
+   */
+  static void Announce (void);
+
+  /**
+   * Check the size of the registry.
+   */
+  void CheckSize (void);
+};
+
+LoRaDownlinkRegistryTestCase::LoRaDownlinkRegistryTestCase ()
+  : TestCase ("Keep the downlink registry bounded without lazy receive windows")
+{
+}
+
+void
+LoRaDownlinkRegistryTestCase::Announce (void)
+{
+  LoRaNetDevice::NotifyDownlink (Mac32Address::Allocate (), Simulator::Now ());
+}
+
+void
+LoRaDownlinkRegistryTestCase::CheckSize (void)
+{
+  // 100 announcements per second stay reachable for 17 s (the longest RX1 delay plus
+  // 2 s), the registry holds at most twice the reachable ones between two sweeps
+  uint32_t reachable = 100*17;
+  NS_TEST_EXPECT_MSG_LT (LoRaNetDevice::GetNAnnouncedDownlinks (), 2*reachable+100,
+                         "registry size at " << Simulator::Now ().GetSeconds () << " s");
+}
+
+void
+LoRaDownlinkRegistryTestCase::DoRun (void)
+{
+  for (uint32_t i = 0; i < 30000; i++)
+    {
+      Simulator::Schedule (MilliSeconds (10*i), &LoRaDownlinkRegistryTestCase::Announce);
+    }
+  for (uint32_t s = 10; s <= 300; s += 10)
+    {
+      Simulator::Schedule (Seconds (s)+MilliSeconds (5), &LoRaDownlinkRegistryTestCase::CheckSize, this);
+    }
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_GT (LoRaNetDevice::GetNAnnouncedDownlinks (), 0, "recent downlinks are kept");
+
+  Simulator::Destroy ();
+  NS_TEST_EXPECT_MSG_EQ (LoRaNetDevice::GetNAnnouncedDownlinks (), 0, "the registry is emptied with the simulator");
+}
+
+/**
+ * \ingroup lora
+ *
+ * Tests of the LoRa end device MAC
+ */
+class LoRaNetDeviceTestSuite : public TestSuite
+{
+public:
+  LoRaNetDeviceTestSuite ();
+};
+
+LoRaNetDeviceTestSuite::LoRaNetDeviceTestSuite ()
+  : TestSuite ("lora-net-device", UNIT)
+{
+  AddTestCase (new LoRaDutyCycleTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaChannelPlanTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaUplinkQueueTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaMacTxDropTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaDownlinkRegistryTestCase, TestCase::QUICK);
+}
+
+static LoRaNetDeviceTestSuite g_loRaNetDeviceTestSuite; //!< the test suite
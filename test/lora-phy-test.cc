@@ -0,0 +1,366 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/packet.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/lora-phy.h>
+#include <ns3/lora-gw-phy.h>
+#include <ns3/lora-phy-header.h>
+#include <ns3/lora-spectrum-signal-parameters.h>
+
+using namespace ns3;
+
+/**
+ * Create a LoRa signal on the receiver grid with a flat power density in its band
+ *
+ * \param txPhy the transmitter
+ * \param channel the carrier frequency (*100Hz)
+ * \param spreading the spreading factor
+ * \param bandwidth the bandwidth (Hz)
+ * \param density the power density (W/Hz)
+ * \param duration the time on air
+ * \return the signal
+ */
+static Ptr<LoRaSpectrumSignalParameters>
+CreateLoRaSignal (Ptr<LoRaPhy> txPhy, uint32_t channel, uint16_t spreading, uint32_t bandwidth, double density, Time duration)
+{
+  Ptr<LoRaSpectrumSignalParameters> params = Create<LoRaSpectrumSignalParameters> ();
+  params->packet = Create<Packet> (10);
+  LoRaPhyHeader header;
+  params->packet->AddHeader (header);
+  params->txPhy = txPhy;
+  params->duration = duration;
+  params->SetChannel (channel);
+  params->SetSpreading (spreading);
+  params->SetBandwidth (bandwidth);
+  params->SetBer (0);
+  Ptr<SpectrumValue> psd = Create<SpectrumValue> (LoRaPhy::GetDefaultRxSpectrumModel ());
+  for (uint32_t k = (channel-8680000-bandwidth/200)/250+1; k < (channel-8680000+bandwidth/200)/250+1; k++)
+    {
+      (*psd)[k] = density;
+    }
+  params->psd = psd;
+  return params;
+}
+
+/**
+ * \ingroup lora
+ *
+ * Receptions of the gateway are kept in a slot per SF class and channel: only
+ * receptions of the same slot or of overlapping channels collide, and slots are
+ * emptied when the receptions end.
+ */
+class LoRaGwSlotsTestCase : public TestCase
+{
+public:
+  LoRaGwSlotsTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Check the number of healthy receptions
+   *
+   * \param total expected receptions on all channels
+   * \param channel a channel (*100Hz)
+   * \param onChannel expected receptions on the channel
+   */
+  void CheckReceptions (uint32_t total, uint32_t channel, uint32_t onChannel);
+
+  /// Count a reception start
+  void ReceptionStart (void);
+  /// Count a decoded packet
+  void ReceptionEnd (Ptr<Packet> packet, uint32_t bandwidth, uint8_t spreading, uint32_t channel, double power);
+  /// Count a lost packet
+  void ReceptionError (void);
+
+  Ptr<LoRaGwPhy> m_gateway; //!< the receiver
+  uint32_t m_starts; //!< receptions started
+  uint32_t m_decoded; //!< packets decoded
+  uint32_t m_errors; //!< packets lost
+};
+
+LoRaGwSlotsTestCase::LoRaGwSlotsTestCase ()
+  : TestCase ("Insert and remove gateway receptions in their slots")
+{
+}
+
+void
+LoRaGwSlotsTestCase::ReceptionStart (void)
+{
+  m_starts++;
+}
+
+void
+LoRaGwSlotsTestCase::ReceptionEnd (Ptr<Packet> packet, uint32_t bandwidth, uint8_t spreading, uint32_t channel, double power)
+{
+  m_decoded++;
+}
+
+void
+LoRaGwSlotsTestCase::ReceptionError (void)
+{
+  m_errors++;
+}
+
+void
+LoRaGwSlotsTestCase::CheckReceptions (uint32_t total, uint32_t channel, uint32_t onChannel)
+{
+  NS_TEST_EXPECT_MSG_EQ (m_gateway->GetReceptions (), total, "healthy receptions at " << Simulator::Now ().GetSeconds ());
+  NS_TEST_EXPECT_MSG_EQ (m_gateway->GetReceptions (channel), onChannel, "healthy receptions on " << channel << " at " << Simulator::Now ().GetSeconds ());
+}
+
+void
+LoRaGwSlotsTestCase::DoRun (void)
+{
+  m_starts = 0;
+  m_decoded = 0;
+  m_errors = 0;
+  m_gateway = CreateObject<LoRaGwPhy> ();
+  m_gateway->SetReceptionStartCallback (MakeCallback (&LoRaGwSlotsTestCase::ReceptionStart, this));
+  m_gateway->SetReceptionEndCallback (MakeCallback (&LoRaGwSlotsTestCase::ReceptionEnd, this));
+  m_gateway->SetReceptionErrorCallback (MakeCallback (&LoRaGwSlotsTestCase::ReceptionError, this));
+  Ptr<LoRaPhy> txPhy = CreateObject<LoRaPhy> ();
+  const double density = 1e-15;
+  const Time duration = Seconds (0.1);
+
+  // different SF classes on one channel and the same SF on separate channels do not collide
+  Simulator::Schedule (Seconds (0), &LoRaGwPhy::StartRx, m_gateway, CreateLoRaSignal (txPhy, 8681000, 7, 125000, density, duration));
+  Simulator::Schedule (Seconds (0), &LoRaGwPhy::StartRx, m_gateway, CreateLoRaSignal (txPhy, 8681000, 9, 125000, density, duration));
+  Simulator::Schedule (Seconds (0), &LoRaGwPhy::StartRx, m_gateway, CreateLoRaSignal (txPhy, 8683000, 7, 125000, density, duration));
+  Simulator::Schedule (Seconds (0.01), &LoRaGwSlotsTestCase::CheckReceptions, this, 3, 8681000, 2);
+  // the same SF class at the same power on the same channel: both are lost
+  Simulator::Schedule (Seconds (0.02), &LoRaGwPhy::StartRx, m_gateway, CreateLoRaSignal (txPhy, 8681000, 7, 125000, density, duration));
+  Simulator::Schedule (Seconds (0.03), &LoRaGwSlotsTestCase::CheckReceptions, this, 2, 8681000, 1);
+  Simulator::Schedule (Seconds (0.03), &LoRaGwSlotsTestCase::CheckReceptions, this, 2, 8683000, 1);
+  // all slots are empty again
+  Simulator::Schedule (Seconds (0.2), &LoRaGwSlotsTestCase::CheckReceptions, this, 0, 8681000, 0);
+  // a later signal finds nothing left of the earlier ones
+  Simulator::Schedule (Seconds (0.3), &LoRaGwPhy::StartRx, m_gateway, CreateLoRaSignal (txPhy, 8681000, 7, 125000, density, duration));
+  Simulator::Schedule (Seconds (0.31), &LoRaGwSlotsTestCase::CheckReceptions, this, 1, 8681000, 1);
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_starts, 5, "every signal starts a reception");
+  NS_TEST_EXPECT_MSG_EQ (m_decoded, 3, "the receptions that did not collide are decoded");
+  NS_TEST_EXPECT_MSG_EQ (m_errors, 2, "the colliding receptions are lost");
+  NS_TEST_EXPECT_MSG_EQ (m_gateway->GetReceptions (), 0, "no reception is left");
+
+  m_gateway = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * An end device keeps the active LoRa signals in a ledger per SF class and channel:
+ * a reception is lost to a stronger signal of its SF class that is still on the air,
+ * not to one that has ended, and not to a signal of another chirp rate.
+ */
+class LoRaLedgerTestCase : public TestCase
+{
+public:
+  LoRaLedgerTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Start listening
+   *
+   * \param channel the carrier frequency (*100Hz)
+   * \param spreading the spreading factor
+   */
+  void Listen (uint32_t channel, uint8_t spreading);
+
+  /// Count a reception start
+  void ReceptionStart (void);
+  /// Count a decoded packet
+  void ReceptionEnd (Ptr<Packet> packet, double ber);
+  /// Count a lost packet
+  void ReceptionError (void);
+
+  Ptr<LoRaPhy> m_phy; //!< the receiver
+  uint32_t m_starts; //!< receptions started
+  uint32_t m_decoded; //!< packets decoded
+  uint32_t m_errors; //!< packets lost
+};
+
+LoRaLedgerTestCase::LoRaLedgerTestCase ()
+  : TestCase ("Insert and remove end device signals in the ledger")
+{
+}
+
+void
+LoRaLedgerTestCase::Listen (uint32_t channel, uint8_t spreading)
+{
+  m_phy->SetChannelIndex (channel);
+  m_phy->SetSpreadingFactor (spreading);
+  m_phy->ChangeState (LoRaRX);
+}
+
+void
+LoRaLedgerTestCase::ReceptionStart (void)
+{
+  m_starts++;
+}
+
+void
+LoRaLedgerTestCase::ReceptionEnd (Ptr<Packet> packet, double ber)
+{
+  m_decoded++;
+}
+
+void
+LoRaLedgerTestCase::ReceptionError (void)
+{
+  m_errors++;
+}
+
+void
+LoRaLedgerTestCase::DoRun (void)
+{
+  m_starts = 0;
+  m_decoded = 0;
+  m_errors = 0;
+  m_phy = CreateObject<LoRaPhy> ();
+  m_phy->SetBandwidth (125000);
+  m_phy->SetReceptionStartCallback (MakeCallback (&LoRaLedgerTestCase::ReceptionStart, this));
+  m_phy->SetReceptionEndCallback (MakeCallback (&LoRaLedgerTestCase::ReceptionEnd, this));
+  m_phy->SetReceptionErrorCallback (MakeCallback (&LoRaLedgerTestCase::ReceptionError, this));
+  Ptr<LoRaPhy> txPhy = CreateObject<LoRaPhy> ();
+  const double density = 1e-15;
+
+  // a stronger signal of the same SF class that is on the air blocks the reception
+  Simulator::Schedule (Seconds (0), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681000, 9, 125000, 10*density, Seconds (0.045)));
+  Simulator::Schedule (Seconds (0.005), &LoRaLedgerTestCase::Listen, this, 8681000, 9);
+  Simulator::Schedule (Seconds (0.01), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681000, 9, 125000, density, Seconds (0.03)));
+  // once both have ended, the ledger no longer holds them
+  Simulator::Schedule (Seconds (0.1), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681000, 9, 125000, density, Seconds (0.05)));
+  // SF10 at 500 kHz is another chirp rate than SF7 at 125 kHz
+  Simulator::Schedule (Seconds (0.2), &LoRaLedgerTestCase::Listen, this, 8683000, 7);
+  Simulator::Schedule (Seconds (0.21), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8683000, 7, 125000, density, Seconds (0.015)));
+  Simulator::Schedule (Seconds (0.215), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8683000, 10, 500000, density, Seconds (0.05)));
+  // a stronger signal of the same SF on an overlapping higher channel ends the reception
+  Simulator::Schedule (Seconds (0.3), &LoRaLedgerTestCase::Listen, this, 8681000, 7);
+  Simulator::Schedule (Seconds (0.31), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681000, 7, 125000, density, Seconds (0.015)));
+  Simulator::Schedule (Seconds (0.312), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681500, 7, 125000, 10*density, Seconds (0.015)));
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_starts, 3, "the blocked signal does not start a reception");
+  NS_TEST_EXPECT_MSG_EQ (m_decoded, 2, "the signals after the blocker and next to the other chirp rate are decoded");
+  NS_TEST_EXPECT_MSG_EQ (m_errors, 1, "the overlapping stronger signal ends the last reception");
+
+  m_phy = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * The ledger of an end device returns the strongest signal of an SF class on the
+ * air that overlaps a channel, optionally without the signal being received.
+ */
+class LoRaStrongestInterfererTestCase : public TestCase
+{
+public:
+  LoRaStrongestInterfererTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Check the strongest interferer of SF7 at 125 kHz
+   *
+   * \param channel the carrier frequency (*100Hz)
+   * \param exclude the signal that is not counted, 0 to count all
+   * \param expected the expected in-band power (W)
+   */
+  void CheckStrongest (uint32_t channel, Ptr<LoRaSpectrumSignalParameters> exclude, double expected);
+
+  Ptr<LoRaPhy> m_phy; //!< the receiver
+};
+
+LoRaStrongestInterfererTestCase::LoRaStrongestInterfererTestCase ()
+  : TestCase ("Find the strongest interferer of an SF class in the ledger")
+{
+}
+
+void
+LoRaStrongestInterfererTestCase::CheckStrongest (uint32_t channel, Ptr<LoRaSpectrumSignalParameters> exclude, double expected)
+{
+  NS_TEST_EXPECT_MSG_EQ_TOL (m_phy->GetStrongestInterferer (channel, 7, 125000, exclude), expected, expected*1e-9+1e-30,
+                             "strongest interferer at " << Simulator::Now ().GetSeconds () << " s");
+}
+
+void
+LoRaStrongestInterfererTestCase::DoRun (void)
+{
+  m_phy = CreateObject<LoRaPhy> ();
+  m_phy->SetBandwidth (125000);
+  Ptr<LoRaPhy> txPhy = CreateObject<LoRaPhy> ();
+  const double density = 1e-15;
+  // in-band power of a 125 kHz signal with this density
+  const double unit = density*125000;
+
+  Ptr<LoRaSpectrumSignalParameters> wanted = CreateLoRaSignal (txPhy, 8681000, 7, 125000, density, Seconds (0.1));
+  Simulator::Schedule (Seconds (0), &LoRaPhy::StartRx, m_phy, wanted);
+  Simulator::Schedule (Seconds (0.005), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, wanted, 0.0);
+  // a stronger signal of the same SF, plus stronger ones of another SF and on another channel
+  Simulator::Schedule (Seconds (0.01), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681000, 7, 125000, 3*density, Seconds (0.03)));
+  Simulator::Schedule (Seconds (0.01), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681000, 9, 125000, 10*density, Seconds (0.1)));
+  Simulator::Schedule (Seconds (0.01), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8685000, 7, 125000, 10*density, Seconds (0.1)));
+  Simulator::Schedule (Seconds (0.02), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, Ptr<LoRaSpectrumSignalParameters> (0), 3*unit);
+  Simulator::Schedule (Seconds (0.02), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, wanted, 3*unit);
+  Simulator::Schedule (Seconds (0.02), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8685000, Ptr<LoRaSpectrumSignalParameters> (0), 10*unit);
+  // once the stronger signal has ended, only the wanted one is left
+  Simulator::Schedule (Seconds (0.05), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, Ptr<LoRaSpectrumSignalParameters> (0), unit);
+  Simulator::Schedule (Seconds (0.05), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, wanted, 0.0);
+  // a signal on an overlapping channel counts with its own in-band power
+  Simulator::Schedule (Seconds (0.06), &LoRaPhy::StartRx, m_phy, CreateLoRaSignal (txPhy, 8681500, 7, 125000, 2*density, Seconds (0.01)));
+  Simulator::Schedule (Seconds (0.065), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, wanted, 2*unit);
+  Simulator::Schedule (Seconds (0.2), &LoRaStrongestInterfererTestCase::CheckStrongest, this, 8681000, Ptr<LoRaSpectrumSignalParameters> (0), 0.0);
+  Simulator::Run ();
+
+  m_phy = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * Tests of the LoRa phys
+ */
+class LoRaPhyTestSuite : public TestSuite
+{
+public:
+  LoRaPhyTestSuite ();
+};
+
+LoRaPhyTestSuite::LoRaPhyTestSuite ()
+  : TestSuite ("lora-phy", UNIT)
+{
+  AddTestCase (new LoRaGwSlotsTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaLedgerTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaStrongestInterfererTestCase, TestCase::QUICK);
+}
+
+static LoRaPhyTestSuite g_loRaPhyTestSuite; //!< the test suite
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KU Leuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Brecht Reynders <brecht.reynders@esat.kuleuven.be>
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/node-container.h>
+#include <ns3/mobility-helper.h>
+#include <ns3/position-allocator.h>
+#include <ns3/lora-helper.h>
+#include <ns3/net-device.h>
+#include <ns3/lora-phy-validator.h>
+#include <ns3/rng-seed-manager.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup lora
+ *
+ * Run a small network in validation mode: the analytic shadows must not need
+ * the MAC callbacks, and both PHYs must receive the isolated uplinks.
+ */
+class LoRaValidationTestCase : public TestCase
+{
+public:
+  LoRaValidationTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Send an uplink of 10 bytes.
+   *
+   * \param device the end device
+   */
+  static void SendUplink (Ptr<NetDevice> device);
+};
+
+LoRaValidationTestCase::LoRaValidationTestCase ()
+  : TestCase ("Run the spectrum and the analytic PHY side by side")
+{
+}
+
+void
+LoRaValidationTestCase::SendUplink (Ptr<NetDevice> device)
+{
+  device->Send (Create<Packet> (10), device->GetBroadcast (), 0);
+}
+
+void
+LoRaValidationTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer gateways;
+  gateways.Create (1);
+  NodeContainer devices;
+  devices.Create (2);
+
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 0));
+  positions->Add (Vector (100, 0, 0));
+  positions->Add (Vector (0, 100, 0));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gateways);
+  mobility.Install (devices);
+
+  LoRaHelper helper;
+  helper.SetPhyMode (LoRaHelper::VALIDATION_PHY);
+  helper.InstallGateways (gateways);
+  NetDeviceContainer netDevices = helper.Install (devices);
+
+  // far enough apart not to collide, and past the duty cycle of the first uplink
+  for (uint32_t i = 0; i < netDevices.GetN (); i++)
+    {
+      Simulator::Schedule (Seconds (1+100*i), &LoRaValidationTestCase::SendUplink, netDevices.Get (i));
+    }
+  Simulator::Stop (Seconds (300));
+  Simulator::Run ();
+
+  Ptr<LoRaPhyValidator> validator = helper.GetValidator ();
+  NS_TEST_ASSERT_MSG_NE (validator, 0, "validation mode creates a validator");
+  NS_TEST_EXPECT_MSG_EQ (validator->GetReceptions (false), 2, "the spectrum PHY receives both uplinks");
+  NS_TEST_EXPECT_MSG_EQ (validator->GetReceptions (true), 2, "the analytic PHY receives both uplinks");
+  NS_TEST_EXPECT_MSG_EQ_TOL (validator->GetDivergence (), 0.0, 1e-9, "both PHYs agree on isolated uplinks");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lora
+ *
+ * Tests of the validation mode
+ */
+class LoRaValidationTestSuite : public TestSuite
+{
+public:
+  LoRaValidationTestSuite ();
+};
+
+LoRaValidationTestSuite::LoRaValidationTestSuite ()
+  : TestSuite ("lora-validation", SYSTEM)
+{
+  AddTestCase (new LoRaValidationTestCase, TestCase::QUICK);
+}
+
+static LoRaValidationTestSuite g_loRaValidationTestSuite; //!< the test suite